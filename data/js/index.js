@@ -2,10 +2,13 @@
 import { setLanguage, currentLanguage } from "./language.js";
 import { scanNetworks, connectToWiFi, resetWiFi } from "./wifimanager.js";
 import { setJobList, updatePlantSelect } from "./scheduler.js";
+import { encode, decode } from "./msgpack.js";
 
 // Initialization
 var gateway = `ws://${window.location.hostname}/ws`;
 export var websocket;
+// Wire format requested for frequent messages, "json" keeps everything as text
+var wireFormat = "msgpack";
 
 window.addEventListener('load', onload);
 var action;
@@ -26,6 +29,10 @@ var use_webserial = document.getElementById("use_webserial");
 var use_flowsensor = document.getElementById("use_flowsensor");
 var use_moisturesensor = document.getElementById("use_moisturesensor");
 var autoSwitchEnabled = document.getElementById("auto_switch_enabled");
+var batchWatering = document.getElementById("batch_watering");
+var pumpCapacityInput = document.getElementById("pump_capacity");
+var catchupPolicySelect = document.getElementById("catchup_policy");
+var catchupWindowInput = document.getElementById("catchup_window");
 
 // Language selection event listener
 var language_select = document.getElementById("language-select");
@@ -34,16 +41,17 @@ language_select.addEventListener("change", e => {
 });
 // Checkbox valve switches event listener
 auto_switch.addEventListener('change', e => {
-    websocket.send(JSON.stringify({"action":"auto_switch","auto_switch":e.target.checked}));
+    sendCommand({"action":"auto_switch","auto_switch":e.target.checked});
 });
 pump_switch.addEventListener('change', e => {
-    websocket.send(JSON.stringify({"action":"pump_switch","pump_switch":e.target.checked}));
+    sendCommand({"action":"pump_switch","pump_switch":e.target.checked});
 });
 
 plantCountInput.addEventListener('change', e => {
     const count = parseInt(e.target.value);
     if (count >= 1 && count <= 8) {
         createValveControls(count);
+        createZoneFlowControls(count);
         updatePlantSelect(count);
     }
 });
@@ -71,14 +79,74 @@ function createValveControls(plantCount) {
         
         // Add event listener
         document.getElementById(`valve_switch_${i+1}`).addEventListener('change', e => {
-            websocket.send(JSON.stringify({
+            sendCommand({
                 "action": "valve_switch",
                 "valve_id": i + 1  // Send 1-based index
-            }));
+            });
         });
     }
 }
 
+// Dynamic creation of per valve flow demand inputs
+function createZoneFlowControls(plantCount, zoneFlow = []) {
+    const zoneFlowContainer = document.getElementById('zone-flow-controls');
+    zoneFlowContainer.innerHTML = '';
+
+    for(let i = 0; i < plantCount; i++) {
+        const row = document.createElement('tr');
+        row.innerHTML = `
+            <td><span data-translate="zone_flow">Flow (ml/min)</span> <span data-translate="plant_">Plant</span> ${i+1}:</td>
+            <td><input type="number" id="zone_flow_${i+1}" min="0" value="${zoneFlow[i] || 0}"></td>
+        `;
+        zoneFlowContainer.appendChild(row);
+    }
+    // Re-apply translations to new elements
+    setLanguage(currentLanguage);
+}
+
+// Per sensor calibration rows, captures the current reading as dry, wet or a given percentage
+function createCalibrationControls(sensors = []) {
+    const calibrationContainer = document.getElementById('calibration-controls');
+    calibrationContainer.innerHTML = '';
+
+    if (!use_moisturesensor.checked) return;
+
+    sensors.forEach(sensor => {
+        const points = sensor.points.map(point => `${point[0]}=${point[1]}%`).join(', ');
+        const row = document.createElement('tr');
+        row.innerHTML = `
+            <td><span data-translate="calibration">Calibration</span> <span data-translate="plant_">Plant</span> ${sensor.id} (${sensor.raw}):
+                <br><small>${points || '-'}</small></td>
+            <td>
+                <input type="button" class="button" data-translate="calibrate_dry" value="Dry">
+                <input type="button" class="button" data-translate="calibrate_wet" value="Wet">
+                <input type="number" id="calibration_percent_${sensor.id}" min="0" max="100" value="50">
+                <input type="button" class="button" data-translate="calibrate_capture" value="Capture">
+                <input type="button" class="button" data-translate="calibrate_reset" value="Reset">
+            </td>
+        `;
+        const buttons = row.querySelectorAll('input[type="button"]');
+        const percentInput = row.querySelector(`#calibration_percent_${sensor.id}`);
+        buttons[0].addEventListener('click', () => captureCalibration(sensor.id, 0));
+        buttons[1].addEventListener('click', () => captureCalibration(sensor.id, 100));
+        buttons[2].addEventListener('click', () => captureCalibration(sensor.id, parseInt(percentInput.value) || 0));
+        buttons[3].addEventListener('click', () => {
+            websocket.send(JSON.stringify({"action": "calibrate_reset", "sensor": sensor.id}));
+        });
+        calibrationContainer.appendChild(row);
+    });
+    // Re-apply translations to new elements
+    setLanguage(currentLanguage);
+}
+
+function captureCalibration(sensorId, percent) {
+    websocket.send(JSON.stringify({
+        "action": "calibrate_capture",
+        "sensor": sensorId,
+        "percent": percent
+    }));
+}
+
 // Reset soil flow volume event listener
 const resetCounterBtn = document.getElementById("resetCounter");
 resetCounterBtn.addEventListener('click', resetCounter);
@@ -125,6 +193,7 @@ function initWebSocket() {
     
     function connect() {
         websocket = new WebSocket(gateway);
+        websocket.binaryType = "arraybuffer";
         websocket.onopen = onOpen;
         websocket.onclose = () => {
             if (retries < maxRetries) {
@@ -146,6 +215,10 @@ function onload(event) {
 
 function onOpen(event) {
     console.log('Connection established');
+    // negotiate the wire format before any data is requested
+    websocket.send(JSON.stringify({"action":"hello","format":wireFormat}));
+    // only receive broadcasts the dashboard shows, logs stay on WebSerial
+    websocket.send(JSON.stringify({"action":"subscribe","topics":["state","settings","jobs","moisture"]}));
     // get initial values data
     getValues();
     // get initial settings data
@@ -155,7 +228,8 @@ function onOpen(event) {
 }
 
 function onMessage(event) {
-    let data = JSON.parse(event.data);
+    // Binary frames are MessagePack, text frames JSON
+    let data = typeof event.data === "string" ? JSON.parse(event.data) : decode(event.data);
 
     console.log('message:',data);
     
@@ -168,8 +242,8 @@ function onMessage(event) {
         action = data.action;
 
         if (action == "setvalues") {
-            // Update dashboard control elements
-            auto_switch.checked = data.auto_switch;
+            // Only fields changed since the last acknowledged version are sent
+            if ('auto_switch' in data) auto_switch.checked = data.auto_switch;
 
             // Handle dynamic valve states
             if (data.valves) {
@@ -182,26 +256,34 @@ function onMessage(event) {
             }
 
             // Update pump control
-            pump_switch.checked = data.pump_switch;
+            if ('pump_switch' in data) pump_switch.checked = data.pump_switch;
             // Update pump run time
-            pumpRunTime.innerText = data.pumpRunTime;
+            if ('pumpRunTime' in data) pumpRunTime.innerText = data.pumpRunTime;
             
             if (data.soilFlowVolume) {
                 // Update soil flow volume
                 soilFlowVolume.innerText = data.soilFlowVolume;
             }
+            sendCommand({"action":"ack","v":data.v});
         } else if (action == "setsettings") {
             // Update settings checkboxes
             use_webserial.checked = data.use_webserial;
             use_flowsensor.checked = data.use_flowsensor;
             use_moisturesensor.checked = data.use_moisturesensor;
             autoSwitchEnabled.checked = data.auto_switch_enabled;
+            batchWatering.checked = data.batch_watering;
             if (data.auto_switch_enabled) auto_switch.checked = data.auto_switch_enabled;
 
             plantCountInput.value = data.plant_count || 3;
             createValveControls(data.plant_count || 3);
             updatePlantSelect(data.plant_count || 3);
 
+            pumpCapacityInput.value = data.pump_capacity || 0;
+            createZoneFlowControls(data.plant_count || 3, data.zone_flow || []);
+
+            catchupPolicySelect.value = data.catchup_policy || 0;
+            catchupWindowInput.value = data.catchup_window || 6;
+
             // Show/hide webserial settings based on use_webserial
             if (use_webserial.checked) {
                 document.querySelector(".topnav .webserial").style.display = "block";
@@ -222,6 +304,10 @@ function onMessage(event) {
             } else {
                 document.querySelector("#moistureSensorsWrapper").style.display = "none";
             }
+        } else if (action == "flowalert") {
+            showFlowAlert(data);
+        } else if (action == "setcalibration") {
+            createCalibrationControls(data.sensors);
         } else if (action == "setjoblist") {
             // Set job list from received joblist data
             setJobList(data.joblist);
@@ -229,6 +315,26 @@ function onMessage(event) {
     }
 }
 
+function showFlowAlert(data) {
+    const valve = data.plant > 0 ? ` on valve ${data.plant}` : '';
+    if (data.type == "dry_run") {
+        alert(`No water flow${valve} while the pump was running. Watering stopped, check the water supply.`);
+    } else if (data.type == "leak") {
+        alert(`Water is flowing (${data.rate} ml/min) with all valves closed. Watering stopped, check for leaks.`);
+    } else if (data.type == "drift") {
+        alert(`Flow${valve} is ${data.rate} ml/min instead of about ${data.expected} ml/min. Watering stopped, check the line.`);
+    }
+}
+
+// Frequent commands go binary once MessagePack was negotiated
+function sendCommand(message) {
+    if (wireFormat == "msgpack") {
+        websocket.send(encode(message));
+    } else {
+        websocket.send(JSON.stringify(message));
+    }
+}
+
 function getValues() {
     websocket.send(JSON.stringify({"action":"getvalues"}));
     // Request moisture sensor data
@@ -237,6 +343,7 @@ function getValues() {
 
 function getSettings() {
     websocket.send(JSON.stringify({"action":"getsettings"}));
+    websocket.send(JSON.stringify({"action":"getcalibration"}));
 }
 
 function getJobList() {
@@ -248,13 +355,24 @@ function resetCounter() {
 }
 
 function saveSettings() {
+    const zoneFlow = [];
+    for (let i = 1; i <= parseInt(plantCountInput.value); i++) {
+        const input = document.getElementById(`zone_flow_${i}`);
+        zoneFlow.push(input ? parseInt(input.value) || 0 : 0);
+    }
+
     websocket.send(JSON.stringify({
         "action": "savesettings",
         "use_webserial": use_webserial.checked,
         "use_flowsensor": use_flowsensor.checked,
         "use_moisturesensor": use_moisturesensor.checked,
         "auto_switch_enabled": autoSwitchEnabled.checked,
-        "plant_count": parseInt(plantCountInput.value)
+        "batch_watering": batchWatering.checked,
+        "plant_count": parseInt(plantCountInput.value),
+        "pump_capacity": parseInt(pumpCapacityInput.value) || 0,
+        "zone_flow": zoneFlow,
+        "catchup_policy": parseInt(catchupPolicySelect.value) || 0,
+        "catchup_window": parseInt(catchupWindowInput.value) || 6
     }));
     toggleOverlay("settings");
 }
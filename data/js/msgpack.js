@@ -0,0 +1,128 @@
+// Minimal MessagePack codec for the binary WebSocket format.
+// Covers the types ArduinoJson writes: nil, bool, integers, floats, strings, arrays and maps.
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+export function encode(value) {
+    const bytes = [];
+    encodeValue(value, bytes);
+    return new Uint8Array(bytes);
+}
+
+function pushUint(bytes, value, size) {
+    for (let shift = (size - 1) * 8; shift >= 0; shift -= 8) {
+        bytes.push(Math.floor(value / 2 ** shift) & 0xff);
+    }
+}
+
+function encodeValue(value, bytes) {
+    if (value === null || value === undefined) {
+        bytes.push(0xc0);
+    } else if (typeof value === "boolean") {
+        bytes.push(value ? 0xc3 : 0xc2);
+    } else if (typeof value === "number") {
+        encodeNumber(value, bytes);
+    } else if (typeof value === "string") {
+        const utf8 = textEncoder.encode(value);
+        if (utf8.length < 32) bytes.push(0xa0 | utf8.length);
+        else if (utf8.length < 0x100) bytes.push(0xd9, utf8.length);
+        else { bytes.push(0xda); pushUint(bytes, utf8.length, 2); }
+        utf8.forEach(b => bytes.push(b));
+    } else if (Array.isArray(value)) {
+        if (value.length < 16) bytes.push(0x90 | value.length);
+        else { bytes.push(0xdc); pushUint(bytes, value.length, 2); }
+        value.forEach(item => encodeValue(item, bytes));
+    } else {
+        const keys = Object.keys(value);
+        if (keys.length < 16) bytes.push(0x80 | keys.length);
+        else { bytes.push(0xde); pushUint(bytes, keys.length, 2); }
+        keys.forEach(key => {
+            encodeValue(key, bytes);
+            encodeValue(value[key], bytes);
+        });
+    }
+}
+
+function encodeNumber(value, bytes) {
+    if (!Number.isInteger(value) || Math.abs(value) > 0xffffffff) {
+        const view = new DataView(new ArrayBuffer(8));
+        view.setFloat64(0, value);
+        bytes.push(0xcb);
+        for (let i = 0; i < 8; i++) bytes.push(view.getUint8(i));
+    } else if (value >= 0) {
+        if (value < 0x80) bytes.push(value);
+        else if (value < 0x100) bytes.push(0xcc, value);
+        else if (value < 0x10000) { bytes.push(0xcd); pushUint(bytes, value, 2); }
+        else { bytes.push(0xce); pushUint(bytes, value, 4); }
+    } else {
+        if (value >= -32) bytes.push(value & 0xff);
+        else if (value >= -0x80) bytes.push(0xd0, value & 0xff);
+        else if (value >= -0x8000) { bytes.push(0xd1); pushUint(bytes, value & 0xffff, 2); }
+        else { bytes.push(0xd2); pushUint(bytes, value >>> 0, 4); }
+    }
+}
+
+export function decode(buffer) {
+    const view = new DataView(buffer);
+    let offset = 0;
+
+    function string(length) {
+        const value = textDecoder.decode(new Uint8Array(buffer, offset, length));
+        offset += length;
+        return value;
+    }
+    function array(length) {
+        const value = [];
+        for (let i = 0; i < length; i++) value.push(next());
+        return value;
+    }
+    function map(length) {
+        const value = {};
+        for (let i = 0; i < length; i++) {
+            const key = next();
+            value[key] = next();
+        }
+        return value;
+    }
+    function read(getter, size) {
+        const value = view[getter](offset);
+        offset += size;
+        return value;
+    }
+
+    function next() {
+        const type = view.getUint8(offset++);
+        if (type < 0x80) return type;
+        if (type < 0x90) return map(type & 0x0f);
+        if (type < 0xa0) return array(type & 0x0f);
+        if (type < 0xc0) return string(type & 0x1f);
+        if (type >= 0xe0) return type - 0x100;
+
+        switch (type) {
+            case 0xc0: return null;
+            case 0xc2: return false;
+            case 0xc3: return true;
+            case 0xca: return read("getFloat32", 4);
+            case 0xcb: return read("getFloat64", 8);
+            case 0xcc: return read("getUint8", 1);
+            case 0xcd: return read("getUint16", 2);
+            case 0xce: return read("getUint32", 4);
+            case 0xcf: return Number(read("getBigUint64", 8));
+            case 0xd0: return read("getInt8", 1);
+            case 0xd1: return read("getInt16", 2);
+            case 0xd2: return read("getInt32", 4);
+            case 0xd3: return Number(read("getBigInt64", 8));
+            case 0xd9: return string(read("getUint8", 1));
+            case 0xda: return string(read("getUint16", 2));
+            case 0xdb: return string(read("getUint32", 4));
+            case 0xdc: return array(read("getUint16", 2));
+            case 0xdd: return array(read("getUint32", 4));
+            case 0xde: return map(read("getUint16", 2));
+            case 0xdf: return map(read("getUint32", 4));
+        }
+        throw new Error(`Unsupported MessagePack type 0x${type.toString(16)}`);
+    }
+
+    return next();
+}
@@ -10,6 +10,7 @@ const jobVolumeInput = document.getElementById("job-volume");
 const jobDurationInput = document.getElementById("job-duration");
 const starttimeInput = document.getElementById("starttime");
 const everydayInput = document.getElementById("everyday");
+const cronInput = document.getElementById("job-cron");
 const addJobButton = document.getElementById("add-job");
 const saveJobsButton = document.getElementById("save-jobs");
 const jobList = document.getElementById("job-list");
@@ -48,6 +49,7 @@ function clearFormAndEditState() {
     jobDurationInput.value = "";
     starttimeInput.value = "";
     everydayInput.checked = false;
+    cronInput.value = "";
     addJobButton.value = "Add Job";
 
     // Update job trigger fields based on default selection
@@ -64,6 +66,7 @@ function populateFormFromJobItem(jobItem) {
     const durationText = jobItem.querySelector('.itemjobduration').innerText || "";
     const starttime = jobItem.querySelector('.itemstarttime').innerText || "";
     const everydayText = jobItem.querySelector('.itemeveryday').innerText || "false";
+    const cron = jobItem.querySelector('.itemcron').innerText || "";
 
     // Add activate button state check
     const activateBtn = jobItem.querySelector('button');
@@ -81,6 +84,7 @@ function populateFormFromJobItem(jobItem) {
     jobDurationInput.value = durationText;
     starttimeInput.value = starttime;
     everydayInput.checked = (everydayText === "true" || everydayText === "True");
+    cronInput.value = cron;
 }
 
 function updatePlantSelect(plantCount) {
@@ -119,6 +123,7 @@ function addJob() {
     const jobduration = jobDurationInput.value;
     const starttime = starttimeInput.value;
     const everyday = everydayInput.checked;
+    const cron = cronInput.value.trim();
     let deadline = "";
 
     if (jobname.trim() === "") {
@@ -126,7 +131,12 @@ function addJob() {
         return; // Don't add task if task or deadline is empty
     }
 
-    if (!jobselect == 1) { // If job type is time-based or both
+    if (cron !== "" && cron.split(/\s+/).length !== 5) {
+        alert("Recurrence needs five fields: minute hour day month weekday.");
+        return;
+    }
+
+    if (!jobselect == 1 && cron === "") { // If job type is time-based or both
         if (starttime === "" && !everyday) {
             alert("Please select an upcoming date for the start time.");
             return;
@@ -172,6 +182,7 @@ function addJob() {
             jobItem.querySelector('.itemjobduration').innerText = jobduration;
             jobItem.querySelector('.itemstarttime').innerText = starttime;
             jobItem.querySelector('.itemeveryday').innerText = everyday ? "true" : "false";
+            jobItem.querySelector('.itemcron').innerText = cron;
             // Clean up the data attribute
             delete addJobButton.dataset.previousState;
             // Reset form and edit state
@@ -213,6 +224,7 @@ function addJob() {
         <p><span data-translate="duration">Duration:</span><span><span class="itemjobduration">${jobduration}</span><span>${jobdurationText}</span><span>sec.</span></span></p>
         <p><span data-translate="start_time">Start:</span><span><span class="itemstarttime">${starttime}</span><span>${starttimeText}</span></span></p>
         <p><span data-translate="every_day_label">Every Day:</span><span><span class="itemeveryday">${everyday}</span><span data-translate="${everydayText}"></span></span></p>
+        <p><span data-translate="recurrence">Recurrence:</span><span><span class="itemcron">${cron}</span><span>${cron ? "" : "--"}</span></span></p>
         <p>
             <span class="itemedit" title="Edit Job">&#9998;</span>
             <span class="itemdelete" title="Delete Job">&#128465;</span>
@@ -275,6 +287,7 @@ function setJobList(data) {
             <p><span data-translate="duration">Duration:</span><span><span class="itemjobduration">${job.duration}</span><span>${jobdurationText}</span><span>sec.</span></span></p>
             <p><span data-translate="start_time">Start:</span><span><span class="itemstarttime">${job.starttime}</span><span>${starttimeText}</span></span></p>
             <p><span data-translate="every_day_label">Every Day:</span><span><span class="itemeveryday">${job.everyday}</span><span data-translate="${everydayText}"></span></span></p>
+            <p><span data-translate="recurrence">Recurrence:</span><span><span class="itemcron">${job.cron || ""}</span><span>${job.cron ? "" : "--"}</span></span></p>
             <p>
                 <span class="itemedit" title="Edit Job">&#9998;</span>
                 <span class="itemdelete" title="Delete Job">&#128465;</span>
@@ -288,35 +301,31 @@ function setJobList(data) {
     updateSaveButtonState();
 }
 
-async function saveJobs() {
+// Uploads the whole list in one message, the controller swaps it in and saves it once
+function saveJobs() {
     const collection = jobList.children;
+    const joblist = [];
 
     for (let i = 0; i < collection.length; i++) {
-        let id = i;
         let active = collection[i].querySelector('button').innerText || "Active";
-        let name = collection[i].querySelector('.itemjobname').innerText || "";
-        let type = parseInt(collection[i].querySelector('.itemjobselect').innerText) || 0;
-        let moistureMin = parseInt(collection[i].querySelector('.itemmoisturemin').innerText) || 0;
-        let moistureMax = parseInt(collection[i].querySelector('.itemmoisturemax').innerText) || 0;
-        let plant = parseInt(collection[i].querySelector('.itemplantselect').innerText) || 0;
-        let volume = parseInt(collection[i].querySelector('.itemjobvolume').innerText) || 0;
-        let duration = parseInt(collection[i].querySelector('.itemjobduration').innerText) || 0;
-        let starttime = collection[i].querySelector('.itemstarttime').innerText || "";
-        let everyday = collection[i].querySelector('.itemeveryday').innerText === "true";
-
-        active = active === "Active" ? true : false;
-
-        console.log(JSON.stringify({"action":"addjobtolist","id":id,"active":active,"name":name,"type":type,"moistureMin":moistureMin,"moistureMax":moistureMax,"plant":plant,"volume":volume,"duration":duration,"starttime":starttime,"everyday":everyday}));
-
-        websocket.send(JSON.stringify({"action":"addjobtolist","id":id,"active":active,"name":name,"type":type,"moistureMin":moistureMin,"moistureMax":moistureMax,"plant":plant,"volume":volume,"duration":duration,"starttime":starttime,"everyday":everyday}));
-        await sleep(200);
-    }
 
-    websocket.send(JSON.stringify({"action":"savejoblist"}));
-}
+        joblist.push({
+            "id": i,
+            "active": active === "Active",
+            "name": collection[i].querySelector('.itemjobname').innerText || "",
+            "type": parseInt(collection[i].querySelector('.itemjobselect').innerText) || 0,
+            "moisture_min": parseInt(collection[i].querySelector('.itemmoisturemin').innerText) || 0,
+            "moisture_max": parseInt(collection[i].querySelector('.itemmoisturemax').innerText) || 0,
+            "plant": parseInt(collection[i].querySelector('.itemplantselect').innerText) || 0,
+            "volume": parseInt(collection[i].querySelector('.itemjobvolume').innerText) || 0,
+            "duration": parseInt(collection[i].querySelector('.itemjobduration').innerText) || 0,
+            "starttime": collection[i].querySelector('.itemstarttime').innerText || "",
+            "everyday": collection[i].querySelector('.itemeveryday').innerText === "true",
+            "cron": collection[i].querySelector('.itemcron').innerText || ""
+        });
+    }
 
-function sleep(ms) {
-    return new Promise(resolve => setTimeout(resolve, ms));
+    websocket.send(JSON.stringify({"action":"setjoblist","joblist":joblist}));
 }
 
 function doJobList(event) {
@@ -359,6 +368,7 @@ function toggleJobTriggerFields() {
     const triggerType = parseInt(document.getElementById('job-select').value);
     const timeField = document.getElementById('starttime');
     const everyDayField = document.getElementById('everyday');
+    const cronField = document.getElementById('job-cron');
     const jobvolume = document.getElementById('job-volume');
     const jobduration = document.getElementById('job-duration');
     const moistureMin = document.getElementById('moisture-min');
@@ -372,6 +382,7 @@ function toggleJobTriggerFields() {
             jobduration.disabled = false;
             timeField.disabled = false;
             everyDayField.disabled = false;
+            cronField.disabled = false;
             break;
         case 1: // Moisture only
             moistureMin.disabled = false;
@@ -380,6 +391,7 @@ function toggleJobTriggerFields() {
             jobduration.disabled = true;
             timeField.disabled = true;
             everyDayField.disabled = true;
+            cronField.disabled = true;
             break;
         case 2: // Both
             moistureMin.disabled = false;
@@ -388,6 +400,7 @@ function toggleJobTriggerFields() {
             jobduration.disabled = false;
             timeField.disabled = true;
             everyDayField.disabled = true;
+            cronField.disabled = true;
             break;
     }
 }
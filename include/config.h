@@ -10,13 +10,57 @@ extern const char* APP_VERSION;
 const int pumpPin = 32;
 const int soilFlowSensorPin = 19;
 
+// Flow sensor pulses per second for a flow of 1 L/min
+static const float FLOW_SENSOR_PULSE_FACTOR = 7.5f;
+static const uint32_t FLOW_GLITCH_FILTER_NS = 10000;  // Pulse counter ignores shorter pulses
+static const unsigned long FLOW_SETTLE_TIME = 5000;  // Flow may lag pump and valve changes this long
+static const uint16_t FLOW_MIN_RATE = 50;            // ml/min, less counts as no flow
+static const uint8_t FLOW_ANOMALY_SAMPLES = 2;       // Consecutive bad samples before acting
+static const uint8_t FLOW_DRIFT_PERCENT = 40;        // Allowed deviation from the learned valve rate
+static const uint8_t FLOW_LEARN_SAMPLES = 10;        // Samples before a learned rate is trusted
+static const uint8_t FLOW_LEARN_SHIFT = 4;           // EMA weight of a new sample is 1/2^shift
+
 // Timing Constants
 static const unsigned long LOG_THROTTLE_MS = 0; //100;
 static const unsigned long WEBSERIAL_FLUSH_INTERVAL = 0; //50;
 static const unsigned long JOB_CHECK_INTERVAL = 1000;
 static const unsigned long NTP_WAIT_LOG_INTERVAL = 2000;
 static const unsigned long WIFI_CHECK_INTERVAL = 30000;  // Check WiFi every 30 seconds
-static const unsigned long MOISTURE_CHECK_INTERVAL = 60000;  // Check moisture every 60 seconds
+static const unsigned long MOISTURE_REPORT_INTERVAL = 60000;  // Moisture history and client updates
+static const unsigned long MOISTURE_SAMPLE_TICK = 1000;       // At most one sensor is read per tick
+static const unsigned long MOISTURE_IDLE_INTERVAL = 300000;   // Per sensor while its plant is idle
+static const unsigned long MOISTURE_ACTIVE_INTERVAL = 5000;   // While the plant's valve is open
+static const unsigned long MOISTURE_ACTIVE_HOLD = 600000;     // Fast sampling after the valve closes
+static const int JOB_START_WINDOW_SEC = 30;  // Time jobs may start this many seconds early or late
+static const int MAX_VOLUME_JOB_DURATION = 900;  // Safety cap in seconds for volume jobs without duration
+static const unsigned long MOISTURE_JOB_COOLDOWN = 3600000;  // Minimum time between moisture runs of one job
+static const size_t MAX_PENDING_JOB_RUNS = 16;
+static const uint8_t MAX_ZONE_RUNS = 8;  // Valves that may water at the same time
+static const unsigned long RUN_JOURNAL_HEARTBEAT = 3600000;   // Record the last known time every hour
+static const size_t RUN_JOURNAL_MAX_BYTES = 4096;  // Compact the journal beyond this size
+static const unsigned long TIMER_TICK_MS = 10;  // Timer wheel resolution
+static const uint8_t MAX_TIMERS = 16;
+static const unsigned long JOB_STATE_INTERVAL = 50;  // Job state machine step while a job runs
+static const unsigned long PUMP_STATUS_INTERVAL = 1000;  // Run time and flow updates while pumping
+static const unsigned long NTP_POLL_INTERVAL = 250;
+static const unsigned long TIMER_STATS_INTERVAL = 3600000;  // Log timer lateness every hour
+static const unsigned long WS_FLUSH_INTERVAL = 250;  // Retry held back WebSocket messages
+static const size_t ADC_BURST_SAMPLES = 15;  // Samples per moisture reading, median filtered
+static const uint8_t ADC_EMA_SHIFT = 2;       // EMA weight of a new reading is 1/2^shift
+static const uint32_t ADC_CONVERSIONS_PER_SAMPLE = 8;  // Hardware averaged in continuous mode
+static const uint32_t ADC_SAMPLE_FREQ_HZ = 20000;
+static const uint8_t MAX_CALIBRATION_POINTS = 8;  // Per moisture sensor
+static const uint8_t MAX_PLANTS = 8;  // Plant count limit of the settings page
+static const size_t MAX_HISTORY_SENSORS = MAX_PLANTS;
+static const uint16_t HISTORY_MINUTE_POINTS = 360;   // 1 minute resolution for 6 hours
+static const uint16_t HISTORY_QUARTER_POINTS = 672;  // 15 minute resolution for 7 days
+static const uint16_t HISTORY_HOUR_POINTS = 720;     // 1 hour resolution for 30 days
+static const size_t MOISTURE_HISTORY_BUDGET = 49152;  // RAM for the history of all sensors
+static const uint16_t MAX_HISTORY_QUERY_POINTS = 720;
+static const uint8_t MAX_WS_CLIENTS = 8;  // AsyncWebSocket default client limit
+static const size_t WS_MESSAGE_MAX_BYTES = 24576;  // Cap for messages reassembled from fragments
+static const size_t WS_CLIENT_QUEUE_DEPTH = 4;  // Queued frames before a client's messages are held back
+static const uint8_t WS_CLIENT_PENDING_MAX = 8;  // Held back messages per client, newer ones are dropped
 
 // NTP Configuration
 extern const char* ntpServer1;
@@ -31,15 +75,33 @@ const unsigned long ntpMaxWait = 10000;
 // Forward declaration
 struct MoistureSensorData;
 
+// Moisture calibration point, a raw ADC reading and the percentage it means
+struct CalibrationPoint {
+    uint16_t raw;
+    uint8_t percent;
+};
+
 // Settings Structure
 struct Settings {
     bool use_webserial = false;
     bool use_flowsensor = false;
     bool use_moisturesensor = false;
     bool auto_switch = false;
+    bool batch_watering = false;    // Keep the pump running between queued jobs
     uint8_t plant_count = 3;
     int valve_start_pin = 25;
     int moisture_start_pin = 33;
+    uint16_t pump_capacity = 0;         // ml/min, 0 waters one zone at a time
+    std::vector<uint16_t> zone_flow;    // ml/min per valve, 0 if unknown
+    uint8_t catchup_policy = 0;         // CatchupPolicy for runs missed while offline
+    uint16_t catchup_window = 6;        // Hours a missed run may still be caught up
+    std::vector<std::vector<CalibrationPoint>> moisture_calibration;  // Per sensor, empty for the default range
+};
+
+// What to do with time triggers missed while rebooting or waiting for NTP
+enum CatchupPolicy {
+    CATCHUP_SKIP = 0,      // Drop missed runs
+    CATCHUP_LATEST = 1     // Run the most recent missed start once
 };
 
 // Job trigger types
@@ -49,6 +111,18 @@ enum JobTrigger {
     TRIGGER_BOTH = 2       // Either condition triggers the job
 };
 
+// Compiled cron recurrence ("minute hour day-of-month month day-of-week")
+struct CronSpec {
+    uint64_t minutes;       // bits 0-59
+    uint32_t hours;         // bits 0-23
+    uint32_t days;          // bits 1-31
+    uint16_t months;        // bits 1-12
+    uint8_t weekdays;       // bits 0-6, Sunday = 0
+    bool anyDay;            // day-of-month was '*'
+    bool anyWeekday;        // day-of-week was '*'
+    bool valid;
+};
+
 // Job Structure
 struct jobStruct {
     int id;
@@ -59,9 +133,15 @@ struct jobStruct {
     int duration;
     char starttime[20];
     bool everyday;
+    char cron[32];          // Optional recurrence, overrides starttime/everyday
     JobTrigger type;        // Job trigger type
     uint8_t moisture_min;   // (0-100%)
     uint8_t moisture_max;   // (0-100%)
+    int32_t startSecOfDay;  // Compiled starttime, -1 if none or invalid
+    uint32_t startDate;     // Compiled date as YYYYMMDD, 0 for daily jobs
+    CronSpec cronSpec;      // Compiled cron, valid only if cron is set
+    int32_t journalKey;     // Hash of name, plant and schedule, ids change on every save
+    uint32_t lastRunMillis; // 0 if not run since boot
 };
 
 // Job DateTime Structure
@@ -81,6 +161,7 @@ enum JobState {
     JOB_OPEN_VALVE,
     JOB_START_PUMP,
     JOB_RUNNING,
+    JOB_HANDOFF_VALVE,
     JOB_STOP_PUMP,
     JOB_CLOSE_VALVE
 };
@@ -102,11 +183,20 @@ enum NtpState {
 // Pump Context
 struct PumpContext {
     PumpState state;
-    unsigned long stateTime;
+    uint32_t stateTime;
     bool manualControl;
     bool targetState;
 };
 
+// Zone Run Context (one per concurrently watering valve)
+struct ZoneRun {
+    jobStruct job;
+    JobState state;
+    uint32_t stateTime;
+    uint32_t startPulses;       // Flow pulse total when pumping started
+    int handoffPlant;           // Previous batch valve, -1 if none
+};
+
 // NTP Context
 struct NtpContext {
     NtpState state;
@@ -127,10 +217,8 @@ extern bool auto_switch;
 extern bool pump_switch;
 extern int pumpState;
 extern float pumpRunTime;
-extern unsigned long pumpStartMillis;
+extern uint32_t pumpStartMillis;
 extern bool jobActive;
-extern JobState currentJobState;
-extern unsigned long jobStateTimestamp;
-extern jobStruct runningJob;
+extern ZoneRun zoneRuns[MAX_ZONE_RUNS];
 extern PumpContext pumpCtx;
 extern NtpContext ntpCtx;
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-channel filter state, the EMA is kept in Q8 fixed point
+struct AdcChannelFilter {
+    int32_t emaQ8;
+    bool primed;
+};
+
+void resetAdcFilter(AdcChannelFilter& filter);
+uint16_t medianOfSamples(uint16_t* samples, size_t count);
+uint16_t applyAdcFilter(AdcChannelFilter& filter, uint16_t* samples, size_t count, uint8_t emaShift);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Raw ADC access, swapped for recorded traces on the host
+struct AdcHal {
+    bool (*begin)(const uint8_t* pins, size_t count);
+    // Fills samples[burst * channels + channel], returns the bursts read
+    size_t (*read)(uint16_t* samples, size_t bursts);
+    // Fills count samples of a single channel, returns the samples read
+    size_t (*readChannel)(size_t channel, uint16_t* samples, size_t count);
+};
+
+void setAdcHal(const AdcHal* hal);
+bool adcBegin(const uint8_t* pins, size_t count);
+size_t adcRead(uint16_t* samples, size_t bursts);
+size_t adcReadChannel(size_t channel, uint16_t* samples, size_t count);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Flow sensor pulse source, swapped for synthetic pulse trains on the host
+struct FlowMeter {
+    bool (*begin)(uint8_t pin);
+    // Pulses since begin, wraps at 32 bits
+    uint32_t (*read)();
+};
+
+void setFlowMeter(const FlowMeter* meter);
+bool flowMeterBegin(uint8_t pin);
+uint32_t flowMeterRead();
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Called after every flow rate update
+typedef void (*FlowListener)(float litersPerMinute);
+
+void setFlowListener(FlowListener listener);
+void initFlowSensor();
+void calculateSoilFlowRate();
+void resetFlowVolume();
+uint32_t getFlowPulseTotal();
+float pulsesToLiters(uint32_t pulses);
+
+extern float soilFlowRate;
+extern float soilFlowVolume;
+extern float roundSoilFlowVolume;
+extern float tempsoilFlowVolume;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "config.h"
+
+// Compiled calibration curve, percentages and slopes in Q16 fixed point
+struct CalibrationSegment {
+    uint16_t rawStart;
+    int32_t percentQ16;
+    int32_t slopeQ16;
+};
+
+struct MoistureCurve {
+    CalibrationSegment segments[MAX_CALIBRATION_POINTS - 1];
+    uint8_t count;
+    uint16_t rawEnd;
+    uint8_t percentEnd;
+};
+
+void compileMoistureCurve(MoistureCurve& curve, const std::vector<CalibrationPoint>& points);
+int moistureCurvePercent(const MoistureCurve& curve, int raw);
+bool setCalibrationPoint(std::vector<CalibrationPoint>& points, uint16_t raw, uint8_t percent);
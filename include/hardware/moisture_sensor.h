@@ -2,17 +2,31 @@
 
 #include <Arduino.h>
 #include <vector>
+#include "hardware/adc_filter.h"
+#include "hardware/moisture_calibration.h"
 
 struct MoistureSensorData {
     uint8_t pin;
-    int analogValue;
+    int analogValue;        // Filtered raw reading
     int percentValue;
     bool isDry;
+    AdcChannelFilter filter;
+    MoistureCurve curve;
+    unsigned long lastSample;
+    unsigned long lastWatered;  // Last time the plant's valve was seen open
+    bool watered;
 };
 
-void readMoistureSensors();
+// Called with the sensor index (== plant) after every fresh reading
+typedef void (*MoistureListener)(size_t plant);
+
+void setMoistureListener(MoistureListener listener);
+void beginMoistureSampling();
+void applyMoistureCalibration();
+void sampleMoistureSensors();
+int captureMoistureRaw(size_t index);
+void sampleDueMoistureSensor();
 std::vector<MoistureSensorData> getMoistureSensorData();
-int mapMoistureToPercent(int analogValue);
 
 extern std::vector<MoistureSensorData> moistureSensors;
 extern const int DRY_ANALOG_VALUE;
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Web asset compiled into the firmware by scripts/compress_assets.py
+struct EmbeddedAsset {
+    const char* path;
+    const char* contentType;
+    const char* etag;
+    const uint8_t* data;
+    size_t length;
+    bool gzipped;
+};
+
+extern const EmbeddedAsset embeddedAssets[];
+extern const size_t embeddedAssetCount;
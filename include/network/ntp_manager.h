@@ -1,3 +1,4 @@
 #pragma once
 
+void initNTPSync();
 void handleNTPSync();
\ No newline at end of file
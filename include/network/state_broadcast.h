@@ -0,0 +1,9 @@
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+
+void publishState();
+void queueStateSnapshot(uint32_t clientId);
+void sendStateSnapshot(AsyncWebSocketClient* client);
+void handleStateAck(AsyncWebSocketClient* client, uint32_t version);
+void forgetStateClient(uint32_t clientId);
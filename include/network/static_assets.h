@@ -0,0 +1,6 @@
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+
+void loadStaticAssets(const char* manifestFile);
+bool serveStaticAsset(AsyncWebServerRequest* request, const String& path);
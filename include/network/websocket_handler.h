@@ -3,15 +3,24 @@
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
 
+struct WsIncoming;
+
 void initWebSocket();
 void notifyClients();
-void handleGetData();
-void handleGetSettings();
+void handleGetSettings(AsyncWebSocketClient* client);
 void handleSaveSettings(const JsonDocument& json);
-void handleGetJobList();
+void handleGetJobList(AsyncWebSocketClient* client);
 void handleAddJobToList(const JsonDocument& json);
+void handleSetJobList(AsyncWebSocketClient* client, const WsIncoming& message);
+void applyPendingJobList();
 void handleAutoSwitch();
 void handleResetCounter();
-void handleGetMoistureSensors();
+void handleGetMoistureSensors(AsyncWebSocketClient* client);
+void handleGetCalibration(AsyncWebSocketClient* client);
+void handleCalibrationCapture(const JsonDocument& json);
+void handleCalibrationReset(const JsonDocument& json);
+void handleGetMoistureHistory(AsyncWebSocketClient* client, const JsonDocument& json);
+void handleGetWsStats(AsyncWebSocketClient* client);
+void sendFlowAlert(const char* type, int plant, int rate, int expected);
 
 extern AsyncWebSocket ws;
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <mutex>
+#include <vector>
+
+// Wire format a client negotiated with the hello action
+enum WsFormat {
+    WS_FORMAT_JSON,
+    WS_FORMAT_MSGPACK
+};
+
+// Broadcast topics a client can subscribe to
+enum WsTopic : uint8_t {
+    WS_TOPIC_STATE = 1 << 0,
+    WS_TOPIC_SETTINGS = 1 << 1,
+    WS_TOPIC_JOBS = 1 << 2,
+    WS_TOPIC_MOISTURE = 1 << 3,
+    WS_TOPIC_LOGS = 1 << 4,
+    // Clients that never subscribed get everything but logs
+    WS_TOPIC_DEFAULT = WS_TOPIC_STATE | WS_TOPIC_SETTINGS | WS_TOPIC_JOBS | WS_TOPIC_MOISTURE
+};
+
+// What happens to a held back message when a newer one of the same action follows
+enum WsDelivery {
+    WS_DELIVER_ALL,     // Replies, alerts and log lines, each one is delivered in order
+    WS_DELIVER_LATEST   // Full state broadcasts, only the newest one matters
+};
+
+// Outbound queue of one client
+struct WsClientStats {
+    uint32_t id;
+    size_t queued;      // Frames in the AsyncWebSocket queue
+    uint8_t pending;    // Held back messages
+    uint32_t deferred;  // Messages held back because the queue was full
+    uint32_t coalesced; // Held back broadcasts replaced by a newer one
+    uint32_t dropped;   // Messages lost because too many were held back
+};
+
+// Client bookkeeping is used from the async_tcp task and the loop task
+extern std::recursive_mutex wsMutex;
+typedef std::lock_guard<std::recursive_mutex> WsLock;
+
+// Complete incoming message, in the frame buffer or reassembled from fragments
+struct WsIncoming {
+    uint8_t* data;
+    size_t length;
+    bool binary;
+};
+
+// Document serialized at most once per wire format, into buffers all client queues share
+struct WsMessage {
+    explicit WsMessage(const JsonDocument& doc) : doc(&doc) {}
+    // Written by the caller, a format left out is never sent
+    WsMessage(AsyncWebSocketSharedBuffer json, AsyncWebSocketSharedBuffer packed) : doc(nullptr), json(json), packed(packed) {}
+
+    void send(AsyncWebSocketClient* client);
+    void clear();
+    AsyncWebSocketSharedBuffer jsonBuffer();
+    AsyncWebSocketSharedBuffer packedBuffer();
+
+    const JsonDocument* doc;
+    AsyncWebSocketSharedBuffer json;
+    AsyncWebSocketSharedBuffer packed;
+};
+
+void setClientFormat(uint32_t clientId, WsFormat format);
+WsFormat clientFormat(uint32_t clientId);
+void setClientTopics(uint32_t clientId, uint8_t topics);
+uint8_t clientTopics(uint32_t clientId);
+uint8_t topicsFromJson(JsonVariantConst names);
+void trackWsClient(uint32_t clientId);
+void forgetWsClient(uint32_t clientId);
+bool wsClientReady(AsyncWebSocketClient* client);
+void flushWsQueues();
+std::vector<WsClientStats> getWsClientStats();
+bool assembleWsMessage(uint32_t clientId, const AwsFrameInfo* info, uint8_t* data, size_t len, WsIncoming& message);
+void releaseWsMessage(uint32_t clientId);
+bool readWsAction(const WsIncoming& message, char* name, size_t size);
+bool decodeWsMessage(const WsIncoming& message, JsonDocument& doc);
+void sendWsMessage(AsyncWebSocketClient* client, uint8_t topic, const JsonDocument& doc, WsDelivery delivery = WS_DELIVER_ALL);
+void sendWsMessage(AsyncWebSocketClient* client, uint8_t topic, WsMessage& message);
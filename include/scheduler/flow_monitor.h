@@ -0,0 +1,14 @@
+#pragma once
+
+#include "config.h"
+
+enum FlowAnomaly {
+    FLOW_OK,
+    FLOW_DRY_RUN,  // Pump running without flow
+    FLOW_LEAK,     // Flow with every valve closed
+    FLOW_DRIFT     // Valve flow far off its learned rate
+};
+
+void handleFlowSample(float litersPerMinute);
+int learnedValveFlow(size_t plant);
+const char* flowAnomalyName(FlowAnomaly anomaly);
@@ -1,5 +1,10 @@
 #pragma once
 
 #include "config.h"
+#include <ArduinoJson.h>
+#include <vector>
 
-jobDateTime parseJobDateTime(const char* starttime);
\ No newline at end of file
+jobDateTime parseJobDateTime(const char* starttime);
+CronSpec parseCronExpression(const char* expr);
+bool jobFromJson(JsonVariantConst obj, jobStruct& job);
+bool jobListFromJson(const char* input, size_t length, std::vector<jobStruct>& jobs);
\ No newline at end of file
@@ -1,3 +1,8 @@
 #pragma once
 
-void jobsProcessor();
\ No newline at end of file
+#include "config.h"
+
+void jobsProcessor();
+void handleMoistureReading(size_t plant);
+int takeNextPendingJob(const ZoneRun* replacing = nullptr);
+void dispatchPendingJobs();
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "config.h"
+
+enum JobRunPriority {
+    JOB_PRIORITY_TIME = 0,      // Scheduled runs go first
+    JOB_PRIORITY_MOISTURE = 1
+};
+
+bool enqueueJobRun(size_t jobIndex, uint8_t priority);
+int peekJobRun();
+int dequeueJobRun();
+size_t pendingJobRunCount();
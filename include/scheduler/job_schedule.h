@@ -0,0 +1,11 @@
+#pragma once
+
+#include "config.h"
+#include <time.h>
+
+void compileJobStartTime(jobStruct& job);
+void invalidateJobSchedule();
+void rebuildJobSchedule(time_t now);
+time_t lastMissedFireTime(const jobStruct& job, time_t since, time_t now);
+int popDueScheduledJob(time_t now, time_t* fireAt = nullptr);
+const std::vector<size_t>& moistureJobsForPlant(size_t plant);
@@ -3,4 +3,7 @@
 #include "config.h"
 
 void processJob(const jobStruct& job);
-void handleJobStateMachine();
\ No newline at end of file
+void handleJobStateMachine();
+bool canStartJob(const jobStruct& job, const ZoneRun* replacing);
+bool isJobRunning(int jobId);
+void abortJobs(const char* reason);
\ No newline at end of file
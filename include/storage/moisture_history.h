@@ -0,0 +1,24 @@
+#pragma once
+
+#include "config.h"
+#include <time.h>
+
+struct MoistureAggregate {
+    uint8_t min;
+    uint8_t max;
+    uint8_t mean;
+};
+
+// Consecutive points of one tier, point i covers start + i * step
+struct MoistureHistoryRange {
+    uint8_t sensor;
+    uint8_t tier;
+    time_t start;
+    uint32_t step;
+    uint16_t count;
+};
+
+void recordMoistureHistory(time_t now);
+void recordMoistureSample(size_t sensor, uint8_t percent, time_t now);
+bool queryMoistureHistory(size_t sensor, time_t from, time_t to, MoistureHistoryRange& range);
+bool moistureHistoryPoint(const MoistureHistoryRange& range, uint16_t index, MoistureAggregate& point);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "config.h"
+#include <time.h>
+
+void loadRunJournal(const char* journalfile);
+void recordJobFire(int32_t jobKey, time_t fireAt);
+time_t lastJobFire(int32_t jobKey);
+time_t lastJournalSeen();
+void flushRunJournal();
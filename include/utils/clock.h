@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+// Time source for the scheduler, swapped out by the host simulator
+struct ClockSource {
+    uint32_t (*millis)();  // 32 bits like the ESP32, so the host sees the same wrap
+    time_t (*time)();
+};
+
+void setClockSource(const ClockSource* source);
+uint32_t clockMillis();
+time_t clockTime();
@@ -2,7 +2,10 @@
 
 #include <Arduino.h>
 
+typedef void (*LogListener)(const char* message);
+
 void initLogger();
+void setLogListener(LogListener listener);
 void logThrottled(const char* format, ...);
 void queueWebSerial(const char* message);
 void processWebSerialQueue();
\ No newline at end of file
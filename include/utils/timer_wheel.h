@@ -0,0 +1,12 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef void (*TimerCallback)();
+
+int startTimer(unsigned long delayMs, unsigned long periodMs, TimerCallback callback);
+void stopTimer(int timerId);
+bool timerActive(int timerId);
+void runTimers();
+unsigned long timerMaxLateness();
+void resetTimerMaxLateness();
@@ -0,0 +1,183 @@
+"""Gzip the web assets in data/ for the filesystem image and record their hashes.
+
+PlatformIO runs this before every firmware build, the output directory is the
+project's data_dir. It can also be run directly:
+
+    python scripts/compress_assets.py [source_dir] [output_dir] [embedded_cpp]
+
+HTML, JS, CSS and JSON files are stored as <name>.gz, everything else as is.
+assets.txt lists "<path> <hash>" per asset, the firmware uses the hash as ETag.
+Stylesheets and the favicon are referenced with ?v=<hash> so browsers may keep
+them for a year. JS modules keep plain URLs since index.js and scheduler.js
+import each other and a versioned URL would load a module twice.
+
+With -D EMBED_WEB_ASSETS in build_flags the same assets are also compiled into
+the firmware as constant arrays plus a lookup table (web_assets.cpp in the
+build directory), gzipped unless -D EMBED_WEB_ASSETS_RAW is given.
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import sys
+
+COMPRESSED = (".html", ".js", ".css", ".json")
+VERSIONED = (".css", ".ico")
+MANIFEST = "assets.txt"
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "text/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".ico": "image/x-icon",
+}
+
+CSS_IMPORT = re.compile(r'@import\s+"([^"?#]+)"')
+HTML_HREF = re.compile(r'href="([^":?#]+)"')
+
+
+def collect(source):
+    files = {}
+    for root, _, names in os.walk(source):
+        for name in names:
+            path = os.path.join(root, name)
+            rel = "/" + os.path.relpath(path, source).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                files[rel] = f.read()
+    return files
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def resolve(base, ref):
+    """Path of a relative reference, like the browser resolves it."""
+    parts = base.split("/")[:-1] + ref.split("/")
+    resolved = []
+    for part in parts:
+        if part == "..":
+            if resolved:
+                resolved.pop()
+        elif part not in ("", "."):
+            resolved.append(part)
+    return "/" + "/".join(resolved)
+
+
+def process(files):
+    """Content and hash of every asset, versioned references rewritten."""
+    done = {}
+
+    def version(base, ref):
+        target = resolve(base, ref)
+        if target not in files or not target.endswith(VERSIONED):
+            return ref
+        return "%s?v=%s" % (ref, build(target)[1])
+
+    def build(path):
+        if path in done:
+            return done[path]
+        data = files[path]
+        if path.endswith(".css"):
+            text = data.decode("utf-8")
+            text = CSS_IMPORT.sub(lambda m: '@import "%s"' % version(path, m.group(1)), text)
+            data = text.encode("utf-8")
+        elif path.endswith(".html"):
+            text = data.decode("utf-8")
+            text = HTML_HREF.sub(lambda m: 'href="%s"' % version(path, m.group(1)), text)
+            data = text.encode("utf-8")
+        done[path] = (data, content_hash(data))
+        return done[path]
+
+    for path in sorted(files):
+        build(path)
+    return done
+
+
+def write(assets, output):
+    if os.path.isdir(output):
+        shutil.rmtree(output)
+
+    original = compressed = 0
+    manifest = []
+    for path, (data, digest) in sorted(assets.items()):
+        target = os.path.join(output, path.lstrip("/"))
+        os.makedirs(os.path.dirname(target), exist_ok=True)
+        if path.endswith(COMPRESSED):
+            # mtime 0 keeps the image identical for identical sources
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            target += ".gz"
+        else:
+            packed = data
+        with open(target, "wb") as f:
+            f.write(packed)
+        manifest.append("%s %s\n" % (path, digest))
+        original += len(data)
+        compressed += len(packed)
+
+    with open(os.path.join(output, MANIFEST), "w") as f:
+        f.writelines(manifest)
+    print("Web assets: %d files, %d bytes, %d gzipped" % (len(assets), original, compressed))
+
+
+def embed(assets, target, gzipped):
+    """C++ source with every asset as a flash array and a table to find them."""
+    lines = ['#include "network/embedded_assets.h"', "", "// Generated by scripts/compress_assets.py, do not edit", ""]
+    table = []
+    size = 0
+    for index, (path, (data, digest)) in enumerate(sorted(assets.items())):
+        packed = gzip.compress(data, compresslevel=9, mtime=0) if gzipped and path.endswith(COMPRESSED) else data
+        lines.append("static const uint8_t asset%d[] = {" % index)
+        for start in range(0, len(packed), 16):
+            lines.append("    " + ", ".join("0x%02x" % b for b in packed[start:start + 16]) + ",")
+        lines.append("};")
+        content_type = CONTENT_TYPES.get(os.path.splitext(path)[1], "application/octet-stream")
+        table.append('    {"%s", "%s", "\\"%s\\"", asset%d, sizeof(asset%d), %s},'
+                     % (path, content_type, digest, index, index, "true" if packed is not data else "false"))
+        size += len(packed)
+
+    lines += ["", "// Sorted by path", "const EmbeddedAsset embeddedAssets[] = {"] + table + ["};", ""]
+    lines.append("const size_t embeddedAssetCount = sizeof(embeddedAssets) / sizeof(embeddedAssets[0]);")
+
+    os.makedirs(os.path.dirname(target), exist_ok=True)
+    with open(target, "w") as f:
+        f.write("\n".join(lines) + "\n")
+    print("Embedded web assets: %d files, %d bytes of flash" % (len(assets), size))
+
+
+def compress_assets(source, output, embed_target=None, embed_gzipped=True):
+    if os.path.abspath(source) == os.path.abspath(output):
+        print("compress_assets: data_dir is the source directory, skipping")
+        return
+    assets = process(collect(source))
+    write(assets, output)
+    if embed_target:
+        embed(assets, embed_target, embed_gzipped)
+
+
+def build_flags(env):
+    flags = env.GetProjectOption("build_flags", [])
+    return " ".join(flags) if isinstance(flags, list) else flags
+
+
+try:
+    Import("env")  # noqa: F821, defined when run by PlatformIO
+    flags = build_flags(env)  # noqa: F821
+    embedded = re.search(r"-D\s*EMBED_WEB_ASSETS\b", flags) is not None
+    generated = os.path.join(env.subst("$BUILD_DIR"), "web_assets_src")  # noqa: F821
+
+    compress_assets(os.path.join(env.subst("$PROJECT_DIR"), "data"),  # noqa: F821
+                    env.subst("$PROJECT_DATA_DIR"),  # noqa: F821
+                    os.path.join(generated, "web_assets.cpp") if embedded else None,
+                    re.search(r"-D\s*EMBED_WEB_ASSETS_RAW\b", flags) is None)
+    if embedded:
+        env.BuildSources(os.path.join("$BUILD_DIR", "web_assets"), generated)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        here = os.path.dirname(os.path.abspath(__file__))
+        compress_assets(sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, "..", "data"),
+                        sys.argv[2] if len(sys.argv) > 2 else os.path.join(here, "..", ".pio", "data"),
+                        sys.argv[3] if len(sys.argv) > 3 else None)
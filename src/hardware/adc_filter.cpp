@@ -0,0 +1,35 @@
+#include "hardware/adc_filter.h"
+
+void resetAdcFilter(AdcChannelFilter& filter) {
+    filter.emaQ8 = 0;
+    filter.primed = false;
+}
+
+// Sorts the burst in place, insertion sort is fastest for a few dozen samples
+uint16_t medianOfSamples(uint16_t* samples, size_t count) {
+    if (count == 0) return 0;
+
+    for (size_t i = 1; i < count; i++) {
+        uint16_t value = samples[i];
+        size_t j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+    return samples[count / 2];
+}
+
+// Median of the burst rejects spikes, the EMA smooths drift between readings
+uint16_t applyAdcFilter(AdcChannelFilter& filter, uint16_t* samples, size_t count, uint8_t emaShift) {
+    int32_t medianQ8 = (int32_t)medianOfSamples(samples, count) << 8;
+
+    if (!filter.primed) {
+        filter.emaQ8 = medianQ8;
+        filter.primed = true;
+    } else {
+        filter.emaQ8 += (medianQ8 - filter.emaQ8) >> emaShift;
+    }
+    return (uint16_t)((filter.emaQ8 + 128) >> 8);
+}
@@ -0,0 +1,122 @@
+#include "hardware/adc_hal.h"
+#include "config.h"
+#include "utils/logger.h"
+
+// Core 3.x offers DMA driven continuous sampling with hardware averaging
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+#define ADC_HAS_CONTINUOUS 1
+#else
+#define ADC_HAS_CONTINUOUS 0
+#endif
+
+static const uint32_t ADC_READ_TIMEOUT_MS = 50;
+
+static std::vector<uint8_t> adcPins;
+
+#if ADC_HAS_CONTINUOUS
+static bool continuousMode = false;
+#endif
+
+static bool esp32AdcBegin(const uint8_t* pins, size_t count) {
+    adcPins.assign(pins, pins + count);
+
+#if ADC_HAS_CONTINUOUS
+    if (continuousMode) {
+        analogContinuousStop();
+        analogContinuousDeinit();
+        continuousMode = false;
+    }
+
+    if (count > 0 &&
+        analogContinuous(pins, count, ADC_CONVERSIONS_PER_SAMPLE, ADC_SAMPLE_FREQ_HZ, nullptr) &&
+        analogContinuousStart()) {
+        continuousMode = true;
+        logThrottled("ADC continuous mode on %d channel(s)", count);
+        return true;
+    }
+    logThrottled("ADC continuous mode unavailable, using single reads");
+#endif
+
+    return true;
+}
+
+static size_t esp32AdcRead(uint16_t* samples, size_t bursts) {
+    size_t channels = adcPins.size();
+
+#if ADC_HAS_CONTINUOUS
+    if (continuousMode) {
+        for (size_t burst = 0; burst < bursts; burst++) {
+            adc_continuous_data_t* result = nullptr;
+            if (!analogContinuousRead(&result, ADC_READ_TIMEOUT_MS)) {
+                return burst;
+            }
+
+            // Each frame holds one hardware averaged value per pin
+            for (size_t channel = 0; channel < channels; channel++) {
+                for (size_t i = 0; i < channels; i++) {
+                    if (result[i].pin == adcPins[channel]) {
+                        samples[burst * channels + channel] = result[i].avg_read_raw;
+                        break;
+                    }
+                }
+            }
+        }
+        return bursts;
+    }
+#endif
+
+    for (size_t burst = 0; burst < bursts; burst++) {
+        for (size_t channel = 0; channel < channels; channel++) {
+            samples[burst * channels + channel] = analogRead(adcPins[channel]);
+        }
+    }
+    return bursts;
+}
+
+static size_t esp32AdcReadChannel(size_t channel, uint16_t* samples, size_t count) {
+    if (channel >= adcPins.size()) return 0;
+
+#if ADC_HAS_CONTINUOUS
+    if (continuousMode) {
+        size_t channels = adcPins.size();
+        for (size_t i = 0; i < count; i++) {
+            adc_continuous_data_t* result = nullptr;
+            if (!analogContinuousRead(&result, ADC_READ_TIMEOUT_MS)) {
+                return i;
+            }
+
+            for (size_t j = 0; j < channels; j++) {
+                if (result[j].pin == adcPins[channel]) {
+                    samples[i] = result[j].avg_read_raw;
+                    break;
+                }
+            }
+        }
+        return count;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = analogRead(adcPins[channel]);
+    }
+    return count;
+}
+
+static const AdcHal esp32Adc = {esp32AdcBegin, esp32AdcRead, esp32AdcReadChannel};
+static const AdcHal* activeAdc = &esp32Adc;
+
+void setAdcHal(const AdcHal* hal) {
+    activeAdc = (hal != nullptr) ? hal : &esp32Adc;
+}
+
+bool adcBegin(const uint8_t* pins, size_t count) {
+    return activeAdc->begin(pins, count);
+}
+
+size_t adcRead(uint16_t* samples, size_t bursts) {
+    return activeAdc->read(samples, bursts);
+}
+
+size_t adcReadChannel(size_t channel, uint16_t* samples, size_t count) {
+    return activeAdc->readChannel(channel, samples, count);
+}
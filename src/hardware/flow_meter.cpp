@@ -0,0 +1,175 @@
+#include "hardware/flow_meter.h"
+#include "config.h"
+#include "utils/logger.h"
+
+// The pulse counter peripheral counts in hardware, core 3.x moved it to a new driver
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+#define FLOW_HAS_PCNT 1
+#include <driver/pulse_cnt.h>
+#elif defined(ESP32)
+#define FLOW_HAS_PCNT 1
+#include <driver/pcnt.h>
+#else
+#define FLOW_HAS_PCNT 0
+#endif
+
+// Interrupt counting, used when no pulse counter unit is available
+static volatile uint32_t isrPulses = 0;
+
+static void IRAM_ATTR countPulse() {
+    isrPulses++;
+}
+
+static bool isrBegin(uint8_t pin) {
+    attachInterrupt(digitalPinToInterrupt(pin), countPulse, FALLING);
+    return true;
+}
+
+// Aligned 32 bit loads are atomic, no need to stop the interrupt
+static uint32_t isrRead() {
+    return isrPulses;
+}
+
+static const FlowMeter isrMeter = {isrBegin, isrRead};
+
+#if FLOW_HAS_PCNT
+static const int PCNT_LIMIT = 30000;
+
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+static pcnt_unit_handle_t pcntUnit = nullptr;
+
+static bool pcntBegin(uint8_t pin) {
+    if (pcntUnit != nullptr) return true;
+
+    // accum_count extends the 16 bit counter across limit crossings
+    pcnt_unit_config_t unitConfig = {};
+    unitConfig.high_limit = PCNT_LIMIT;
+    unitConfig.low_limit = -PCNT_LIMIT;
+    unitConfig.flags.accum_count = 1;
+    if (pcnt_new_unit(&unitConfig, &pcntUnit) != ESP_OK) {
+        pcntUnit = nullptr;
+        return false;
+    }
+
+    pcnt_glitch_filter_config_t filterConfig = {};
+    filterConfig.max_glitch_ns = FLOW_GLITCH_FILTER_NS;
+    pcnt_unit_set_glitch_filter(pcntUnit, &filterConfig);
+
+    pcnt_chan_config_t channelConfig = {};
+    channelConfig.edge_gpio_num = pin;
+    channelConfig.level_gpio_num = -1;
+    pcnt_channel_handle_t channel = nullptr;
+    if (pcnt_new_channel(pcntUnit, &channelConfig, &channel) != ESP_OK) {
+        pcnt_del_unit(pcntUnit);
+        pcntUnit = nullptr;
+        return false;
+    }
+
+    // Count falling edges like the interrupt handler
+    pcnt_channel_set_edge_action(channel, PCNT_CHANNEL_EDGE_ACTION_HOLD, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+    pcnt_unit_add_watch_point(pcntUnit, PCNT_LIMIT);
+    pcnt_unit_enable(pcntUnit);
+    pcnt_unit_clear_count(pcntUnit);
+    pcnt_unit_start(pcntUnit);
+    return true;
+}
+
+static uint32_t pcntRead() {
+    int count = 0;
+    pcnt_unit_get_count(pcntUnit, &count);
+    return (uint32_t)count;
+}
+#else
+static const pcnt_unit_t PCNT_FLOW_UNIT = PCNT_UNIT_0;
+
+static volatile uint32_t pcntOverflows = 0;
+static uint32_t pcntLastTotal = 0;
+static bool pcntStarted = false;
+
+static void IRAM_ATTR pcntOverflow(void* arg) {
+    pcntOverflows++;
+}
+
+static bool pcntBegin(uint8_t pin) {
+    if (pcntStarted) return true;
+
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pin;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = PCNT_FLOW_UNIT;
+    config.pos_mode = PCNT_COUNT_DIS;
+    config.neg_mode = PCNT_COUNT_INC;  // Falling edges like the interrupt handler
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = PCNT_LIMIT;
+    config.counter_l_lim = -PCNT_LIMIT;
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        return false;
+    }
+
+    // Filter length is given in 80 MHz APB cycles, at most 1023
+    uint32_t filterCycles = FLOW_GLITCH_FILTER_NS * 80 / 1000;
+    pcnt_set_filter_value(PCNT_FLOW_UNIT, filterCycles > 1023 ? 1023 : filterCycles);
+    pcnt_filter_enable(PCNT_FLOW_UNIT);
+
+    pcnt_event_enable(PCNT_FLOW_UNIT, PCNT_EVT_H_LIM);
+    esp_err_t err = pcnt_isr_service_install(0);
+    if ((err != ESP_OK && err != ESP_ERR_INVALID_STATE) ||
+        pcnt_isr_handler_add(PCNT_FLOW_UNIT, pcntOverflow, nullptr) != ESP_OK) {
+        return false;
+    }
+
+    pcnt_counter_pause(PCNT_FLOW_UNIT);
+    pcnt_counter_clear(PCNT_FLOW_UNIT);
+    pcnt_counter_resume(PCNT_FLOW_UNIT);
+    pcntStarted = true;
+    return true;
+}
+
+static uint32_t pcntRead() {
+    uint32_t overflows;
+    int16_t count;
+    do {
+        overflows = pcntOverflows;
+        pcnt_get_counter_value(PCNT_FLOW_UNIT, &count);
+    } while (overflows != pcntOverflows);
+
+    // The counter restarts at the limit just before the overflow interrupt runs
+    uint32_t total = overflows * PCNT_LIMIT + count;
+    if ((int32_t)(total - pcntLastTotal) < 0) {
+        total += PCNT_LIMIT;
+    }
+    pcntLastTotal = total;
+    return total;
+}
+#endif
+
+static const FlowMeter pcntMeter = {pcntBegin, pcntRead};
+static const FlowMeter* defaultMeter = &pcntMeter;
+#else
+static const FlowMeter* defaultMeter = &isrMeter;
+#endif
+
+static const FlowMeter* activeMeter = defaultMeter;
+
+void setFlowMeter(const FlowMeter* meter) {
+    activeMeter = (meter != nullptr) ? meter : defaultMeter;
+}
+
+bool flowMeterBegin(uint8_t pin) {
+    if (activeMeter->begin(pin)) {
+        return true;
+    }
+    if (activeMeter == &isrMeter) {
+        return false;
+    }
+
+    logThrottled("Pulse counter unavailable, counting flow pulses by interrupt");
+    activeMeter = &isrMeter;
+    return activeMeter->begin(pin);
+}
+
+uint32_t flowMeterRead() {
+    return activeMeter->read();
+}
@@ -0,0 +1,67 @@
+#include "hardware/flow_sensor.h"
+#include "hardware/flow_meter.h"
+#include "config.h"
+#include "utils/clock.h"
+
+// Flow sensor variables
+float soilFlowRate = 0.0;
+float soilFlowVolume = 0.0;
+float roundSoilFlowVolume = 0.0;
+float tempsoilFlowVolume = 0.0;
+
+static const float LITERS_PER_PULSE = 1.0f / (FLOW_SENSOR_PULSE_FACTOR * 60.0f);
+
+// Pulse totals at the last volume reset and the last rate update
+static uint32_t volumeStartPulses = 0;
+static uint32_t ratePulses = 0;
+static uint32_t lastFlowSample = 0;
+
+static FlowListener flowListener = nullptr;
+
+void setFlowListener(FlowListener listener) {
+    flowListener = listener;
+}
+
+void initFlowSensor() {
+    flowMeterBegin(soilFlowSensorPin);
+    volumeStartPulses = ratePulses = flowMeterRead();
+    lastFlowSample = clockMillis();
+}
+
+float pulsesToLiters(uint32_t pulses) {
+    return pulses * LITERS_PER_PULSE;
+}
+
+void calculateSoilFlowRate() {
+    uint32_t now = clockMillis();
+    uint32_t total = flowMeterRead();
+    uint32_t elapsed = now - lastFlowSample;
+
+    soilFlowRate = (elapsed > 0) ? pulsesToLiters(total - ratePulses) * 60000.0f / elapsed : 0.0f;
+    soilFlowVolume = pulsesToLiters(total - volumeStartPulses);
+    roundSoilFlowVolume = round(soilFlowVolume * 100) / 100;
+
+    if (roundSoilFlowVolume != tempsoilFlowVolume) {
+        tempsoilFlowVolume = roundSoilFlowVolume;
+    }
+
+    ratePulses = total;
+    lastFlowSample = now;
+
+    if (flowListener) {
+        flowListener(soilFlowRate);
+    }
+}
+
+void resetFlowVolume() {
+    volumeStartPulses = ratePulses = flowMeterRead();
+    lastFlowSample = clockMillis();
+    soilFlowRate = 0.0;
+    soilFlowVolume = 0.0;
+    roundSoilFlowVolume = 0.0;
+    tempsoilFlowVolume = 0.0;
+}
+
+uint32_t getFlowPulseTotal() {
+    return flowMeterRead();
+}
@@ -0,0 +1,83 @@
+#include "hardware/moisture_calibration.h"
+#include "hardware/moisture_sensor.h"
+#include <algorithm>
+
+static bool rawBelow(const CalibrationPoint& a, const CalibrationPoint& b) {
+    return a.raw < b.raw;
+}
+
+// Precompute one segment per pair of neighbouring points, sorted by raw value.
+// With fewer than two points the global dry/wet range fills the gap.
+void compileMoistureCurve(MoistureCurve& curve, const std::vector<CalibrationPoint>& points) {
+    std::vector<CalibrationPoint> sorted = points;
+    if (sorted.size() < 2) {
+        const CalibrationPoint defaults[] = {{(uint16_t)DRY_ANALOG_VALUE, (uint8_t)DRY_PERCENT},
+                                             {(uint16_t)WET_ANALOG_VALUE, (uint8_t)WET_PERCENT}};
+        for (const CalibrationPoint& point : defaults) {
+            if (sorted.empty() || sorted[0].percent != point.percent) {
+                sorted.push_back(point);
+            }
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), rawBelow);
+    if (sorted.size() > MAX_CALIBRATION_POINTS) {
+        sorted.resize(MAX_CALIBRATION_POINTS);
+    }
+
+    curve.count = 0;
+    for (size_t i = 0; i + 1 < sorted.size(); i++) {
+        const CalibrationPoint& from = sorted[i];
+        const CalibrationPoint& to = sorted[i + 1];
+        if (to.raw == from.raw) continue;
+
+        CalibrationSegment& segment = curve.segments[curve.count++];
+        segment.rawStart = from.raw;
+        segment.percentQ16 = (int32_t)from.percent << 16;
+        segment.slopeQ16 = (((int32_t)to.percent - from.percent) << 16) / ((int32_t)to.raw - from.raw);
+    }
+
+    curve.rawEnd = sorted.back().raw;
+    curve.percentEnd = sorted.back().percent;
+
+    // All points on the same raw value, map everything to that percentage
+    if (curve.count == 0) {
+        curve.segments[0] = {curve.rawEnd, (int32_t)curve.percentEnd << 16, 0};
+        curve.count = 1;
+    }
+}
+
+int moistureCurvePercent(const MoistureCurve& curve, int raw) {
+    if (raw >= curve.rawEnd) {
+        return curve.percentEnd;
+    }
+
+    const CalibrationSegment* segment = &curve.segments[0];
+    if (raw <= segment->rawStart) {
+        return segment->percentQ16 >> 16;
+    }
+    for (uint8_t i = 1; i < curve.count && curve.segments[i].rawStart <= raw; i++) {
+        segment = &curve.segments[i];
+    }
+
+    int32_t percentQ16 = segment->percentQ16 + segment->slopeQ16 * (raw - segment->rawStart);
+    int percent = (percentQ16 + 0x8000) >> 16;
+    return constrain(percent, 0, 100);
+}
+
+// Replace the point for the same percentage or raw value, else add one
+bool setCalibrationPoint(std::vector<CalibrationPoint>& points, uint16_t raw, uint8_t percent) {
+    for (CalibrationPoint& point : points) {
+        if (point.percent == percent || point.raw == raw) {
+            point = {raw, percent};
+            std::sort(points.begin(), points.end(), rawBelow);
+            return true;
+        }
+    }
+
+    if (points.size() >= MAX_CALIBRATION_POINTS) {
+        return false;
+    }
+    points.push_back({raw, percent});
+    std::sort(points.begin(), points.end(), rawBelow);
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "hardware/moisture_sensor.h"
+#include "hardware/adc_hal.h"
 #include "config.h"
 #include "utils/logger.h"
 
@@ -10,45 +11,138 @@ const int WET_PERCENT = 100;
 
 std::vector<MoistureSensorData> moistureSensors;
 
-int mapMoistureToPercent(int analogValue) {
-    // Constrain the value to valid range
-    analogValue = constrain(analogValue, WET_ANALOG_VALUE, DRY_ANALOG_VALUE);
-    
-    // Map analog value to percentage (inverted: higher analog = drier = lower percentage)
-    return map(analogValue, DRY_ANALOG_VALUE, WET_ANALOG_VALUE, DRY_PERCENT, WET_PERCENT);
+static MoistureListener moistureListener = nullptr;
+
+void setMoistureListener(MoistureListener listener) {
+    moistureListener = listener;
+}
+
+// Compile each sensor's calibration points from the settings
+void applyMoistureCalibration() {
+    static const std::vector<CalibrationPoint> noPoints;
+
+    for (size_t i = 0; i < moistureSensors.size(); i++) {
+        const std::vector<CalibrationPoint>& points =
+            i < settings.moisture_calibration.size() ? settings.moisture_calibration[i] : noPoints;
+        compileMoistureCurve(moistureSensors[i].curve, points);
+    }
+}
+
+// Hand the sensor pins to the ADC and start with fresh filters
+void beginMoistureSampling() {
+    std::vector<uint8_t> pins;
+    for (MoistureSensorData& sensor : moistureSensors) {
+        pins.push_back(sensor.pin);
+        resetAdcFilter(sensor.filter);
+    }
+    adcBegin(pins.data(), pins.size());
+    applyMoistureCalibration();
+}
+
+static void applySensorSamples(MoistureSensorData& sensor, uint16_t* samples, size_t count) {
+    sensor.analogValue = applyAdcFilter(sensor.filter, samples, count, ADC_EMA_SHIFT);
+    sensor.percentValue = moistureCurvePercent(sensor.curve, sensor.analogValue);
+    sensor.isDry = (sensor.percentValue < 20);
+}
+
+// Burst-sample all sensors and run each channel through its filter
+void sampleMoistureSensors() {
+    static std::vector<uint16_t> samples;
+    size_t channels = moistureSensors.size();
+    if (channels == 0) return;
+
+    samples.resize(ADC_BURST_SAMPLES * channels);
+    size_t bursts = adcRead(samples.data(), ADC_BURST_SAMPLES);
+    if (bursts == 0) {
+        logThrottled("ADC read failed, keeping last moisture values");
+        return;
+    }
+
+    uint16_t channelSamples[ADC_BURST_SAMPLES];
+    for (size_t channel = 0; channel < channels; channel++) {
+        MoistureSensorData& sensor = moistureSensors[channel];
+        for (size_t burst = 0; burst < bursts; burst++) {
+            channelSamples[burst] = samples[burst * channels + channel];
+        }
+
+        applySensorSamples(sensor, channelSamples, bursts);
+        sensor.lastSample = millis();
+    }
 }
 
-void readMoistureSensors() {
+// Single channel reading, used by the staggered sampler
+static bool sampleMoistureSensor(size_t index) {
+    uint16_t samples[ADC_BURST_SAMPLES];
+    size_t count = adcReadChannel(index, samples, ADC_BURST_SAMPLES);
+    if (count == 0) {
+        logThrottled("ADC read of sensor %u failed, keeping last value", (unsigned)(index + 1));
+        return false;
+    }
+
+    applySensorSamples(moistureSensors[index], samples, count);
+    moistureSensors[index].lastSample = millis();
+    return true;
+}
+
+// Fresh reading of one sensor for calibration, its EMA restarts so the
+// value does not lag behind a probe that was just moved
+int captureMoistureRaw(size_t index) {
+    if (index >= moistureSensors.size()) return -1;
+
+    resetAdcFilter(moistureSensors[index].filter);
+    sampleMoistureSensor(index);
+    return moistureSensors[index].analogValue;
+}
+
+// Fast while the plant's valve is open and for a while after, slow otherwise
+static unsigned long sampleInterval(const MoistureSensorData& sensor, unsigned long now) {
+    if (sensor.watered && now - sensor.lastWatered < MOISTURE_ACTIVE_HOLD) {
+        return MOISTURE_ACTIVE_INTERVAL;
+    }
+    return MOISTURE_IDLE_INTERVAL;
+}
+
+// Reads the most overdue sensor, so channels are never read all at once
+void sampleDueMoistureSensor() {
     if (!settings.use_moisturesensor || moistureSensors.empty()) {
         return;
     }
 
-    static unsigned long lastDetailedLog = 0;
     unsigned long now = millis();
-    bool shouldLogDetails = (now - lastDetailedLog >= 300000); // 5 minutes
+    int due = -1;
+    long mostOverdue = -1;
 
     for (size_t i = 0; i < moistureSensors.size(); i++) {
-        moistureSensors[i].analogValue = analogRead(moistureSensors[i].pin);
-        moistureSensors[i].percentValue = mapMoistureToPercent(moistureSensors[i].analogValue);
-        moistureSensors[i].isDry = (moistureSensors[i].percentValue < 20);
-
-        if (shouldLogDetails) {
-            logThrottled("Sensor %d (Pin %d): Raw=%d, Moisture=%d%%, Status=%s",
-                        i + 1,
-                        moistureSensors[i].pin,
-                        moistureSensors[i].analogValue,
-                        moistureSensors[i].percentValue,
-                        moistureSensors[i].isDry ? "DRY" : "OK");
+        MoistureSensorData& sensor = moistureSensors[i];
+        if (i < valveStates.size() && valveStates[i] == HIGH) {
+            sensor.watered = true;
+            sensor.lastWatered = now;
         }
-        
-        if (moistureSensors[i].isDry) {
-            logThrottled("WARNING: Plant %d is dry! Moisture: %d%%", 
-                        i + 1, moistureSensors[i].percentValue);
+
+        long overdue = (long)(now - sensor.lastSample) - (long)sampleInterval(sensor, now);
+        if (overdue > mostOverdue) {
+            mostOverdue = overdue;
+            due = i;
         }
     }
-    
-    if (shouldLogDetails) {
-        lastDetailedLog = now;
+
+    if (due < 0 || !sampleMoistureSensor(due)) {
+        return;
+    }
+
+    const MoistureSensorData& sensor = moistureSensors[due];
+    if (sampleInterval(sensor, now) == MOISTURE_IDLE_INTERVAL) {
+        logThrottled("Sensor %d (Pin %d): Raw=%d, Moisture=%d%%, Status=%s",
+                    due + 1, sensor.pin, sensor.analogValue, sensor.percentValue,
+                    sensor.isDry ? "DRY" : "OK");
+
+        if (sensor.isDry) {
+            logThrottled("WARNING: Plant %d is dry! Moisture: %d%%", due + 1, sensor.percentValue);
+        }
+    }
+
+    if (moistureListener != nullptr) {
+        moistureListener(due);
     }
 }
 
@@ -44,16 +44,21 @@ void initializeMoisturePins() {
         sensor.analogValue = 0;
         sensor.percentValue = 0;
         sensor.isDry = false;
+        sensor.lastSample = 0;
+        sensor.lastWatered = 0;
+        sensor.watered = false;
 
         //pinMode(sensor.pin, INPUT);
         
-        // Read initial value
-        sensor.analogValue = analogRead(sensor.pin);
-        sensor.percentValue = mapMoistureToPercent(sensor.analogValue);
-        sensor.isDry = (sensor.percentValue < 20);
-        
         moistureSensors.push_back(sensor);
+    }
+
+    // Read initial values, this also primes the filters
+    beginMoistureSampling();
+    sampleMoistureSensors();
 
+    for (size_t i = 0; i < moistureSensors.size(); i++) {
+        const MoistureSensorData& sensor = moistureSensors[i];
         logThrottled("Moisture sensor %d initialized on pin %d (Initial: %d%%, Raw: %d)", 
                      i + 1, sensor.pin, sensor.percentValue, sensor.analogValue);
     }
@@ -1,9 +1,10 @@
 #include "hardware/pump_control.h"
 #include "config.h"
 #include "utils/logger.h"
+#include "utils/clock.h"
 
 void handlePumpSwitch(bool manual) {
-    unsigned long now = millis();
+    uint32_t now = clockMillis();
     bool stateChanged = false;
     bool anyValveOpen = false;
 
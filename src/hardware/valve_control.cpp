@@ -3,6 +3,16 @@
 #include "config.h"
 #include "utils/logger.h"
 
+// True if any valve other than valveNum is open
+static bool otherValveOpen(uint8_t valveNum) {
+    for (uint8_t i = 0; i < settings.plant_count; i++) {
+        if (i != valveNum && valve_switches[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void handleValveSwitch(uint8_t valveNum) {
     if (valveNum >= settings.plant_count) {
         logThrottled("Invalid valve number: %d", valveNum);
@@ -11,7 +21,8 @@ void handleValveSwitch(uint8_t valveNum) {
     
     bool currentState = valve_switches[valveNum];
     if (currentState) {
-        if (pumpCtx.state != PUMP_RUNNING) {
+        // A running pump always needs at least one open valve
+        if (pumpCtx.state != PUMP_RUNNING || otherValveOpen(valveNum)) {
             digitalWrite(valvePins[valveNum], LOW);
             valve_switches[valveNum] = false;
             valveStates[valveNum] = LOW;
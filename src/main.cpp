@@ -15,17 +15,25 @@
 
 #include "config.h"
 #include "utils/logger.h"
+#include "utils/timer_wheel.h"
+#include "utils/clock.h"
 #include "hardware/pin_manager.h"
 #include "hardware/valve_control.h"
 #include "hardware/pump_control.h"
 #include "hardware/moisture_sensor.h"
+#include "hardware/flow_sensor.h"
 #include "network/wifi_manager.h"
 #include "network/websocket_handler.h"
+#include "network/ws_protocol.h"
 #include "network/ntp_manager.h"
+#include "network/static_assets.h"
 #include "storage/filesystem_manager.h"
 #include "storage/config_manager.h"
+#include "storage/run_journal.h"
+#include "storage/moisture_history.h"
 #include "scheduler/job_processor.h"
 #include "scheduler/job_state_machine.h"
+#include "scheduler/flow_monitor.h"
 
 // Define version
 const char* APP_VERSION = "0.9.1";
@@ -50,54 +58,24 @@ bool pump_switch = false;
 
 int pumpState = 0;
 float pumpRunTime = 0;
-unsigned long pumpStartMillis = 0;
+uint32_t pumpStartMillis = 0;
 
 bool jobActive = false;
-JobState currentJobState = JOB_IDLE;
-unsigned long jobStateTimestamp = 0;
-jobStruct runningJob;
+ZoneRun zoneRuns[MAX_ZONE_RUNS];
 
 PumpContext pumpCtx = {PUMP_IDLE, 0, false, false};
 NtpContext ntpCtx = {NTP_IDLE, 0, 0, false, 0};
 
-// Flow sensor variables
-volatile int pulseCount = 0;
-float soilFlowRate = 0.0;
-float soilFlowVolume = 0.0;
-float roundSoilFlowVolume = 0.0;
-float tempsoilFlowVolume = 0.0;
-
-// Timing variables
-unsigned long lastTime = 0;
-unsigned long timerDelay = 1000;
-
-static unsigned long lastJobCheck = 0;
-static unsigned long lastWiFiCheck = 0;
-static unsigned long lastMoistureCheck = 0;
 volatile bool otaUpdating = false;
+// Set by web handlers, the loop task flushes the journal and restarts
+static volatile bool restartRequested = false;
 
 // Server and file paths
 AsyncWebServer server(80);
 const char* configfile = "/config.json";
 const char* jobsfile = "/schedules.json";
-
-void IRAM_ATTR pulseCounter() {
-    pulseCount++;
-}
-
-void calculateSoilFlowRate() {
-    detachInterrupt(digitalPinToInterrupt(soilFlowSensorPin));
-    soilFlowRate = ((1000.0 / (millis() - lastTime)) * pulseCount) / 7.5;
-    soilFlowVolume += (soilFlowRate / 60.0);
-    roundSoilFlowVolume = round(soilFlowVolume * 100) / 100;
-    
-    if (roundSoilFlowVolume != tempsoilFlowVolume) {
-        tempsoilFlowVolume = roundSoilFlowVolume;
-    }
-    
-    pulseCount = 0;
-    attachInterrupt(digitalPinToInterrupt(soilFlowSensorPin), pulseCounter, FALLING);
-}
+const char* journalfile = "/runjournal.bin";
+const char* assetsfile = "/assets.txt";
 
 void recvMsg(uint8_t *data, size_t len) {
     logThrottled("Received Data...");
@@ -110,14 +88,17 @@ void recvMsg(uint8_t *data, size_t len) {
 
 void handleRoot(AsyncWebServerRequest *request) {
     // If in AP mode (not connected to WiFi), redirect to WiFi manager
-    if (WiFi.getMode() == WIFI_AP) {
-        request->send(LittleFS, "/wifimanager.html", "text/html");
-    } else {
-        request->send(LittleFS, "/index.html", "text/html");
+    const char* page = (WiFi.getMode() == WIFI_AP) ? "/wifimanager.html" : "/index.html";
+    if (!serveStaticAsset(request, page)) {
+        request->send(404, "text/plain", "File Not Found\n\n");
     }
 }
 
+// Static files are looked up here instead of in serveStatic handlers
 void handleNotFound(AsyncWebServerRequest *request) {
+    if (request->method() == HTTP_GET && serveStaticAsset(request, request->url())) {
+        return;
+    }
     request->send(404, "text/plain", "File Not Found\n\n");
 }
 
@@ -201,15 +182,69 @@ void handleConnect(AsyncWebServerRequest *request) {
     request->send(200, "text/plain", "Credentials saved. Connecting...");
     
     // Restart ESP32 to connect with new credentials
-    delay(1000);
-    ESP.restart();
+    restartRequested = true;
 }
 
 void handleResetWiFi(AsyncWebServerRequest *request) {
     resetWiFiSettings();
     request->send(200, "text/plain", "WiFi settings reset. Restarting...");
-    delay(1000);
-    ESP.restart();
+    restartRequested = true;
+}
+
+// Periodic WiFi connection check
+void wifiCheckTask() {
+    // Only check if we're supposed to be in station mode
+    // Check if scan is NOT running before attempting reconnection
+    int scanStatus = WiFi.scanComplete();
+    if (scanStatus != WIFI_SCAN_RUNNING && (WiFi.getMode() == WIFI_STA || WiFi.getMode() == WIFI_AP_STA)) {
+        if (!checkWiFiConnection()) {
+            logThrottled("WiFi reconnection failed, will retry in 30s");
+        }
+    }
+}
+
+void jobCheckTask() {
+    if (WiFi.status() == WL_CONNECTED && auto_switch) {
+        jobsProcessor();
+    }
+}
+
+void pumpStatusTask() {
+    // The flow monitor also watches for leaks while the pump is off
+    if (settings.use_flowsensor || pumpState == HIGH) {
+        calculateSoilFlowRate();
+    }
+
+    if (WiFi.status() == WL_CONNECTED && pumpState == HIGH) {
+        pumpRunTime = (millis() - pumpStartMillis) / 1000.0f;
+        notifyClients();
+    }
+}
+
+void moistureSampleTask() {
+    if (WiFi.status() == WL_CONNECTED) {
+        // Read at most one sensor, fast on plants being watered
+        sampleDueMoistureSensor();
+    }
+}
+
+void moistureReportTask() {
+    if (WiFi.status() == WL_CONNECTED) {
+        recordMoistureHistory(clockTime());
+        // Inform clients about updated moisture readings
+        handleGetMoistureSensors(nullptr);
+    }
+}
+
+void wsFlushTask() {
+    // Held back messages first, then state deltas skipped for congested clients
+    flushWsQueues();
+    notifyClients();
+}
+
+void timerStatsTask() {
+    logThrottled("Timer lateness max: %lums", timerMaxLateness());
+    resetTimerMaxLateness();
 }
 
 void setup() {
@@ -218,6 +253,7 @@ void setup() {
     Serial.printf("Application version: %s\n", APP_VERSION);
     
     initFS();
+    loadStaticAssets(assetsfile);
     initWiFi(); // Custom WiFi Manager
     initWebSocket();
     
@@ -229,11 +265,18 @@ void setup() {
     initializeValvePins();
     initializeMoisturePins();
 
-    // Load job list
+    // Moisture jobs are evaluated on every fresh reading
+    setMoistureListener(handleMoistureReading);
+
+    // Dry run, leak and drift checks on every flow rate update
+    setFlowListener(handleFlowSample);
+
+    // Load job list and the last run of each job
     loadJobList(jobsfile);
+    loadRunJournal(journalfile);
 
-    // Setup flow sensor interrupt
-    attachInterrupt(digitalPinToInterrupt(soilFlowSensorPin), pulseCounter, FALLING);
+    // Setup flow sensor pulse counting
+    initFlowSensor();
     
     // Read initial pump state
     pumpState = digitalRead(pumpPin);
@@ -249,6 +292,7 @@ void setup() {
         logThrottled("OTA start");
     });
     ArduinoOTA.onEnd([]() {
+        flushRunJournal();
         otaUpdating = false;
         logThrottled("OTA end");
     });
@@ -275,10 +319,6 @@ void setup() {
     // Regular routes
     server.on("/", HTTP_GET, handleRoot);
     server.onNotFound(handleNotFound);
-    server.serveStatic("/", LittleFS, "/");
-    server.serveStatic("/js/", LittleFS, "/js/");
-    server.serveStatic("/css/", LittleFS, "/css/");
-    server.serveStatic("/lang/", LittleFS, "/lang/");
     
     // Add WebSocket handler
     server.addHandler(&ws);
@@ -288,65 +328,33 @@ void setup() {
     logThrottled("HTTP server started");
     
     // Initialize NTP
-    ntpCtx.state = NTP_INIT;
-    ntpCtx.stateTime = millis();
-    ntpCtx.syncInProgress = true;
+    initNTPSync();
+
+    // Periodic tasks, the job state machine and NTP arm their own timers
+    startTimer(WIFI_CHECK_INTERVAL, WIFI_CHECK_INTERVAL, wifiCheckTask);
+    startTimer(JOB_CHECK_INTERVAL, JOB_CHECK_INTERVAL, jobCheckTask);
+    startTimer(PUMP_STATUS_INTERVAL, PUMP_STATUS_INTERVAL, pumpStatusTask);
+    startTimer(MOISTURE_SAMPLE_TICK, MOISTURE_SAMPLE_TICK, moistureSampleTask);
+    startTimer(MOISTURE_REPORT_INTERVAL, MOISTURE_REPORT_INTERVAL, moistureReportTask);
+    startTimer(TIMER_STATS_INTERVAL, TIMER_STATS_INTERVAL, timerStatsTask);
+    startTimer(WS_FLUSH_INTERVAL, WS_FLUSH_INTERVAL, wsFlushTask);
 }
 
 void loop() {
-    unsigned long now = millis();
-    
-    // Periodic WiFi connection check (every 30 seconds)
-    if (now - lastWiFiCheck >= WIFI_CHECK_INTERVAL) {
-        // Only check if we're supposed to be in station mode
-        // Check if scan is NOT running before attempting reconnection
-        int scanStatus = WiFi.scanComplete();
-        if (scanStatus != WIFI_SCAN_RUNNING && (WiFi.getMode() == WIFI_STA || WiFi.getMode() == WIFI_AP_STA)) {
-            if (!checkWiFiConnection()) {
-                logThrottled("WiFi reconnection failed, will retry in 30s");
-            }
-        }
-        lastWiFiCheck = now;
-    }
+    runTimers();
 
     // Only run main functionality if connected to WiFi in station mode
     if (WiFi.status() == WL_CONNECTED) {
         ArduinoOTA.handle();
-        ws.cleanupClients();
-        
-        handleJobStateMachine();
-        
-        if (auto_switch) {
-            if (now - lastJobCheck >= JOB_CHECK_INTERVAL) {
-                jobsProcessor();
-                lastJobCheck = now;
-            }
-        }
-        
-        if (pumpState == HIGH) {
-            if ((millis() - lastTime) > timerDelay) {
-                pumpRunTime = (millis() - pumpStartMillis) / 1000.0f;
-                calculateSoilFlowRate();
-                notifyClients();
-                lastTime = millis();
-            }
-        }
-
-        // Periodic moisture sensor check (every 60 seconds)
-        if (now - lastMoistureCheck >= MOISTURE_CHECK_INTERVAL) {
-            // Read moisture sensors
-            readMoistureSensors();
-            // Inform clients about updated moisture readings
-            handleGetMoistureSensors();
-            lastMoistureCheck = now;
-        }
+    }
+    ws.cleanupClients();
+    applyPendingJobList();
 
-        processWebSerialQueue();
-        handleNTPSync();
-    } else {
-        // In AP mode or disconnected, still handle web server and WebSerial
-        ws.cleanupClients();
-        processWebSerialQueue();
+    if (restartRequested) {
+        flushRunJournal();
+        // Let the handler's response go out first
+        delay(1000);
+        ESP.restart();
     }
     
     yield();
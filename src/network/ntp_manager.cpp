@@ -1,6 +1,9 @@
 #include "network/ntp_manager.h"
 #include "config.h"
 #include "utils/logger.h"
+#include "scheduler/job_schedule.h"
+#include "utils/timer_wheel.h"
+#include <WiFi.h>
 #include <time.h>
 
 extern volatile bool otaUpdating;
@@ -11,8 +14,27 @@ extern const long gmtOffset_sec;
 extern const int daylightOffset_sec;
 extern const char* timezone;
 
+static int ntpTimer = -1;
+
+void initNTPSync() {
+    ntpCtx.state = NTP_INIT;
+    ntpCtx.stateTime = millis();
+    ntpCtx.syncInProgress = true;
+    ntpTimer = startTimer(0, NTP_POLL_INTERVAL, handleNTPSync);
+}
+
+// Sleep until the next sync is due, then poll again
+static void scheduleNextNTPSync(unsigned long now) {
+    unsigned long elapsed = now - ntpCtx.lastSync;
+    unsigned long delay = elapsed < ntpSyncInterval ? ntpSyncInterval - elapsed : 0;
+
+    stopTimer(ntpTimer);
+    ntpTimer = startTimer(delay, NTP_POLL_INTERVAL, handleNTPSync);
+}
+
+// Timer callback, polls while a sync is in progress or due
 void handleNTPSync() {
-    if (otaUpdating || jobActive) return;
+    if (otaUpdating || jobActive || WiFi.status() != WL_CONNECTED) return;
     
     unsigned long now = millis();
     
@@ -26,6 +48,7 @@ void handleNTPSync() {
                 logThrottled("Starting NTP sync...");
                 // Don't break - continue to NTP_INIT immediately
             } else {
+                scheduleNextNTPSync(now);
                 break;
             }
             // Fall through to NTP_INIT
@@ -55,6 +78,8 @@ void handleNTPSync() {
                 ntpCtx.state = NTP_DONE;
                 ntpCtx.lastSync = now;
                 ntpCtx.syncInProgress = false;
+                // Fire times depend on the wall clock and timezone
+                invalidateJobSchedule();
                 logThrottled("NTP sync complete - Time set to: %04d-%02d-%02d %02d:%02d:%02d",
                     timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
                     timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
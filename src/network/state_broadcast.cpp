@@ -0,0 +1,201 @@
+#include "network/state_broadcast.h"
+#include "network/websocket_handler.h"
+#include "network/ws_protocol.h"
+#include "config.h"
+#include "utils/logger.h"
+#include <ArduinoJson.h>
+
+// Dashboard values, one valve field per plant follows the fixed ones
+enum StateField {
+    STATE_AUTO_SWITCH,
+    STATE_PUMP_SWITCH,
+    STATE_PUMP_RUN_TIME,
+    STATE_FIRST_VALVE
+};
+
+static const size_t STATE_FIELD_COUNT = STATE_FIRST_VALVE + MAX_PLANTS;
+static const size_t STATE_JSON_SIZE = JSON_OBJECT_SIZE(7) + JSON_ARRAY_SIZE(MAX_PLANTS) +
+                                      MAX_PLANTS * JSON_OBJECT_SIZE(2) + 32;
+
+// Last published value and the version it changed in
+static int32_t stateValues[STATE_FIELD_COUNT];
+static uint32_t fieldVersions[STATE_FIELD_COUNT];
+static uint32_t stateVersion = 1;
+static uint8_t publishedValves = 0;
+
+// Version each client acknowledged, deltas are relative to it
+struct StateClient {
+    uint32_t id;
+    uint32_t acked;  // 0 until the first acknowledgement, gets full state
+    uint32_t sent;
+    bool used;
+};
+
+static StateClient stateClients[MAX_WS_CLIENTS];
+
+static StateClient* findStateClient(uint32_t id, bool create) {
+    StateClient* freeEntry = nullptr;
+    for (StateClient& entry : stateClients) {
+        if (entry.used && entry.id == id) return &entry;
+        if (!entry.used && !freeEntry) freeEntry = &entry;
+    }
+    if (!create) return nullptr;
+
+    // Entries of clients that went away without a disconnect event
+    if (!freeEntry) {
+        for (StateClient& entry : stateClients) {
+            if (ws.client(entry.id) == nullptr) {
+                freeEntry = &entry;
+                break;
+            }
+        }
+    }
+    if (freeEntry) {
+        *freeEntry = {id, 0, 0, true};
+    }
+    return freeEntry;
+}
+
+static void readState(int32_t* values) {
+    values[STATE_AUTO_SWITCH] = auto_switch;
+    values[STATE_PUMP_SWITCH] = pump_switch;
+    values[STATE_PUMP_RUN_TIME] = lroundf(pumpRunTime * 100);
+    for (uint8_t i = 0; i < MAX_PLANTS; i++) {
+        bool open = i < settings.plant_count && i < valve_switches.size() && valve_switches[i];
+        values[STATE_FIRST_VALVE + i] = open;
+    }
+}
+
+// All fields changed since the last call share one new version
+static void updateStateVersion() {
+    int32_t values[STATE_FIELD_COUNT];
+    readState(values);
+
+    bool valvesResized = settings.plant_count != publishedValves;
+    bool changed = false;
+    for (size_t field = 0; field < STATE_FIELD_COUNT; field++) {
+        if (values[field] != stateValues[field] || (valvesResized && field >= STATE_FIRST_VALVE)) {
+            stateValues[field] = values[field];
+            fieldVersions[field] = stateVersion + 1;
+            changed = true;
+        }
+    }
+    if (changed) stateVersion++;
+    publishedValves = settings.plant_count;
+}
+
+static void stateMessage(uint32_t since, JsonDocument& doc) {
+    bool full = (since == 0);
+
+    doc.clear();
+    doc["action"] = "setvalues";
+    doc["v"] = stateVersion;
+    if (full) doc["full"] = true;
+
+    if (full || fieldVersions[STATE_AUTO_SWITCH] > since) {
+        doc["auto_switch"] = stateValues[STATE_AUTO_SWITCH] != 0;
+    }
+    if (full || fieldVersions[STATE_PUMP_SWITCH] > since) {
+        doc["pump_switch"] = stateValues[STATE_PUMP_SWITCH] != 0;
+    }
+    if (full || fieldVersions[STATE_PUMP_RUN_TIME] > since) {
+        doc["pumpRunTime"] = String(stateValues[STATE_PUMP_RUN_TIME] / 100.0f, 2);
+    }
+
+    JsonArray valveArray;
+    for (uint8_t i = 0; i < settings.plant_count && i < MAX_PLANTS; i++) {
+        size_t field = STATE_FIRST_VALVE + i;
+        if (!full && fieldVersions[field] <= since) continue;
+
+        if (valveArray.isNull()) valveArray = doc.createNestedArray("valves");
+        JsonObject valve = valveArray.createNestedObject();
+        valve["id"] = i + 1;
+        valve["state"] = stateValues[field] != 0;
+    }
+}
+
+// Send each client what changed since its acknowledged version
+void publishState() {
+    WsLock lock(wsMutex);
+    updateStateVersion();
+
+    StaticJsonDocument<STATE_JSON_SIZE> doc;
+    WsMessage message(doc);
+    uint32_t docSince = UINT32_MAX;
+    for (StateClient& entry : stateClients) {
+        if (!entry.used || entry.sent >= stateVersion) continue;
+        if (!(clientTopics(entry.id) & WS_TOPIC_STATE)) continue;
+
+        AsyncWebSocketClient* client = ws.client(entry.id);
+        if (client == nullptr) {
+            entry.used = false;
+            continue;
+        }
+        // A congested client gets everything since its ack once it drains
+        if (!wsClientReady(client)) continue;
+
+        // Clients in step with each other share the message
+        if (entry.acked != docSince) {
+            stateMessage(entry.acked, doc);
+            message.clear();
+            docSince = entry.acked;
+        }
+        message.send(client);
+        entry.sent = stateVersion;
+    }
+}
+
+// Full state with the next publish, in the format the client negotiated by then
+void queueStateSnapshot(uint32_t clientId) {
+    WsLock lock(wsMutex);
+    StateClient* entry = findStateClient(clientId, true);
+    if (entry == nullptr) {
+        logThrottled("No state slot for client #%u", clientId);
+        return;
+    }
+    entry->acked = 0;
+    entry->sent = 0;
+}
+
+// Full state right away when a client asks to resync
+void sendStateSnapshot(AsyncWebSocketClient* client) {
+    WsLock lock(wsMutex);
+    updateStateVersion();
+
+    StateClient* entry = findStateClient(client->id(), true);
+    if (entry == nullptr) {
+        logThrottled("No state slot for client #%u", client->id());
+    } else {
+        entry->acked = 0;
+        entry->sent = stateVersion;
+    }
+    StaticJsonDocument<STATE_JSON_SIZE> doc;
+    stateMessage(0, doc);
+    WsMessage(doc).send(client);
+}
+
+void handleStateAck(AsyncWebSocketClient* client, uint32_t version) {
+    WsLock lock(wsMutex);
+    StateClient* entry = findStateClient(client->id(), false);
+    if (entry == nullptr) {
+        sendStateSnapshot(client);
+        return;
+    }
+
+    // A version from before a restart can not be used as a base
+    if (version > stateVersion) {
+        sendStateSnapshot(client);
+        return;
+    }
+    if (version > entry->acked) {
+        entry->acked = version;
+    }
+}
+
+void forgetStateClient(uint32_t clientId) {
+    WsLock lock(wsMutex);
+    StateClient* entry = findStateClient(clientId, false);
+    if (entry != nullptr) {
+        entry->used = false;
+    }
+}
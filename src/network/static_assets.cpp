@@ -0,0 +1,124 @@
+#include "network/static_assets.h"
+#include "utils/logger.h"
+#ifdef EMBED_WEB_ASSETS
+#include "network/embedded_assets.h"
+#endif
+#include <LittleFS.h>
+#include <vector>
+
+// Content hash per asset, from the manifest scripts/compress_assets.py writes
+struct StaticAsset {
+    String path;
+    String etag;
+};
+
+static std::vector<StaticAsset> staticAssets;
+
+static const char* CACHE_IMMUTABLE = "public, max-age=31536000, immutable";
+static const char* CACHE_REVALIDATE = "no-cache";
+
+void loadStaticAssets(const char* manifestFile) {
+    staticAssets.clear();
+
+#ifdef EMBED_WEB_ASSETS
+    logThrottled("Serving %u embedded assets", (unsigned)embeddedAssetCount);
+#endif
+
+    File file = LittleFS.open(manifestFile, "r");
+    if (!file) {
+        logThrottled("No asset manifest, serving files without ETags");
+        return;
+    }
+
+    while (file.available()) {
+        String line = file.readStringUntil('\n');
+        int space = line.indexOf(' ');
+        if (space <= 0) continue;
+
+        String hash = line.substring(space + 1);
+        hash.trim();
+        staticAssets.push_back({line.substring(0, space), "\"" + hash + "\""});
+    }
+    file.close();
+
+    logThrottled("Loaded %u asset hashes", (unsigned)staticAssets.size());
+}
+
+static const StaticAsset* findAsset(const String& path) {
+    for (const StaticAsset& asset : staticAssets) {
+        if (asset.path == path) return &asset;
+    }
+    return nullptr;
+}
+
+#ifdef EMBED_WEB_ASSETS
+// The generated table is sorted by path
+static const EmbeddedAsset* findEmbeddedAsset(const String& path) {
+    size_t low = 0;
+    size_t high = embeddedAssetCount;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        int cmp = strcmp(embeddedAssets[mid].path, path.c_str());
+        if (cmp == 0) return &embeddedAssets[mid];
+        if (cmp < 0) low = mid + 1;
+        else high = mid;
+    }
+    return nullptr;
+}
+#endif
+
+// A URL with the current hash never changes, everything else is revalidated
+static const char* cacheControlFor(AsyncWebServerRequest* request, const String& etag) {
+    bool versioned = request->hasParam("v") && "\"" + request->getParam("v")->value() + "\"" == etag;
+    return versioned ? CACHE_IMMUTABLE : CACHE_REVALIDATE;
+}
+
+static bool sendNotModified(AsyncWebServerRequest* request, const String& etag, const char* cacheControl) {
+    if (!request->hasHeader("If-None-Match") || request->header("If-None-Match").indexOf(etag) < 0) return false;
+
+    AsyncWebServerResponse* response = request->beginResponse(304);
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+    return true;
+}
+
+bool serveStaticAsset(AsyncWebServerRequest* request, const String& path) {
+#ifdef EMBED_WEB_ASSETS
+    const EmbeddedAsset* embedded = findEmbeddedAsset(path);
+    if (embedded != nullptr) {
+        String etag = embedded->etag;
+        const char* cacheControl = cacheControlFor(request, etag);
+        if (sendNotModified(request, etag, cacheControl)) return true;
+
+        // Sent in chunks straight from the memory mapped flash, no copy in RAM
+        AsyncWebServerResponse* response = request->beginResponse(200, embedded->contentType, embedded->data, embedded->length);
+        if (embedded->gzipped) response->addHeader("Content-Encoding", "gzip");
+        response->addHeader("ETag", etag);
+        response->addHeader("Cache-Control", cacheControl);
+        request->send(response);
+        return true;
+    }
+#endif
+
+    const StaticAsset* asset = findAsset(path);
+
+    // Plain data/ uploaded without the build step
+    if (asset == nullptr) {
+        if (!LittleFS.exists(path)) return false;
+        AsyncWebServerResponse* response = request->beginResponse(LittleFS, path);
+        response->addHeader("Cache-Control", CACHE_REVALIDATE);
+        request->send(response);
+        return true;
+    }
+
+    const char* cacheControl = cacheControlFor(request, asset->etag);
+    if (sendNotModified(request, asset->etag, cacheControl)) return true;
+
+    // The file response finds <path>.gz and sets Content-Encoding
+    AsyncWebServerResponse* response = request->beginResponse(LittleFS, path);
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+    return true;
+}
@@ -1,13 +1,21 @@
 #include "network/websocket_handler.h"
+#include "network/state_broadcast.h"
+#include "network/ws_protocol.h"
 #include "storage/config_manager.h"
 #include "storage/filesystem_manager.h"
 #include "hardware/valve_control.h"
 #include "hardware/pump_control.h"
 #include "hardware/moisture_sensor.h"
+#include "hardware/flow_sensor.h"
 #include "hardware/pin_manager.h"
+#include "scheduler/job_schedule.h"
+#include "scheduler/job_parser.h"
+#include "storage/moisture_history.h"
+#include "utils/clock.h"
 #include "config.h"
 #include "utils/logger.h"
 #include <ArduinoJson.h>
+#include <stdarg.h>
 
 AsyncWebSocket ws("/ws");
 
@@ -15,42 +23,11 @@ extern const char* configfile;
 extern const char* jobsfile;
 
 void notifyClients() {
-    handleGetData();
+    publishState();
 }
 
-void handleGetData() {
-    if (valvePins.empty() || valve_switches.empty() || valveStates.empty()) {
-        logThrottled("Error: Valve arrays not initialized");
-        return;
-    }
-
-    String Text;
-    
-    const size_t capacity = JSON_OBJECT_SIZE(4) + 
-                           JSON_ARRAY_SIZE(settings.plant_count) + 
-                           settings.plant_count * JSON_OBJECT_SIZE(2) + 
-                           128;
-    DynamicJsonDocument root(capacity);
-
-    root["action"] = "setvalues";
-    root["auto_switch"] = auto_switch;
-    root["pump_switch"] = pump_switch;
-    root["pumpRunTime"] = String(pumpRunTime, 2);
-
-    JsonArray valveArray = root.createNestedArray("valves");
-    for(uint8_t i = 0; i < settings.plant_count && i < valve_switches.size(); i++) {
-        JsonObject valve = valveArray.createNestedObject();
-        valve["id"] = i + 1;
-        valve["state"] = bool(valve_switches[i]);
-    }
-
-    serializeJson(root, Text);
-    ws.textAll(Text);
-}
-
-void handleGetSettings() {
-    String Text;
-    const uint8_t size = JSON_OBJECT_SIZE(7);
+void handleGetSettings(AsyncWebSocketClient *client) {
+    const size_t size = JSON_OBJECT_SIZE(12) + JSON_ARRAY_SIZE(8);
     StaticJsonDocument<size> json;
 
     json.clear();
@@ -59,10 +36,18 @@ void handleGetSettings() {
     json["use_flowsensor"] = settings.use_flowsensor;
     json["use_moisturesensor"] = settings.use_moisturesensor;
     json["auto_switch_enabled"] = settings.auto_switch;
+    json["batch_watering"] = settings.batch_watering;
     json["plant_count"] = settings.plant_count;
+    json["pump_capacity"] = settings.pump_capacity;
+    json["catchup_policy"] = settings.catchup_policy;
+    json["catchup_window"] = settings.catchup_window;
 
-    serializeJson(json, Text);
-    ws.textAll(Text);
+    JsonArray zoneFlow = json.createNestedArray("zone_flow");
+    for (uint16_t flow : settings.zone_flow) {
+        zoneFlow.add(flow);
+    }
+
+    sendWsMessage(client, WS_TOPIC_SETTINGS, json, WS_DELIVER_LATEST);
 }
 
 void handleSaveSettings(const JsonDocument& json) {
@@ -70,6 +55,7 @@ void handleSaveSettings(const JsonDocument& json) {
     settings.use_flowsensor = json["use_flowsensor"] | false;
     settings.use_moisturesensor = json["use_moisturesensor"] | false;
     settings.auto_switch = json["auto_switch_enabled"] | false;
+    settings.batch_watering = json["batch_watering"] | false;
     
     if (settings.auto_switch) auto_switch = settings.auto_switch;
     
@@ -81,16 +67,26 @@ void handleSaveSettings(const JsonDocument& json) {
         initializeMoisturePins();
     }
 
+    settings.pump_capacity = json["pump_capacity"] | 0;
+    settings.catchup_policy = json["catchup_policy"] | CATCHUP_SKIP;
+    settings.catchup_window = json["catchup_window"] | 6;
+    settings.zone_flow.assign(settings.plant_count, 0);
+    for (uint8_t i = 0; i < settings.plant_count; i++) {
+        settings.zone_flow[i] = json["zone_flow"][i] | 0;
+    }
+    settings.moisture_calibration.resize(settings.plant_count);
+
     saveConfiguration(configfile);
-    handleGetSettings();
+    handleGetSettings(nullptr);
+    handleGetCalibration(nullptr);
 }
 
-void handleGetJobList() {
+void handleGetJobList(AsyncWebSocketClient *client) {
     int arrayCount = joblistVec.empty() ? 1 : joblistVec.size();
     
     const size_t capacity = JSON_OBJECT_SIZE(2) +
                            JSON_ARRAY_SIZE(arrayCount) +
-                           (arrayCount * JSON_OBJECT_SIZE(11)) +
+                           (arrayCount * JSON_OBJECT_SIZE(12)) +
                            (arrayCount * 128);
     
     DynamicJsonDocument doc(capacity);
@@ -112,11 +108,10 @@ void handleGetJobList() {
         obj["duration"] = job.duration;
         obj["starttime"] = job.starttime;
         obj["everyday"] = job.everyday;
+        obj["cron"] = job.cron;
     }
 
-    String Text;
-    serializeJson(doc, Text);
-    ws.textAll(Text);
+    sendWsMessage(client, WS_TOPIC_JOBS, doc, WS_DELIVER_LATEST);
 }
 
 void handleAddJobToList(const JsonDocument& json) {
@@ -131,6 +126,7 @@ void handleAddJobToList(const JsonDocument& json) {
     if (newId == 0) {
         logThrottled("First job id, clearing existing job list");
         joblistVec.clear();
+        invalidateJobSchedule();
     }
 
     for (const jobStruct& job : joblistVec) {
@@ -140,24 +136,94 @@ void handleAddJobToList(const JsonDocument& json) {
         }
     }
 
-    newJob.id = newId;
-    newJob.active = json["active"] | false;
-    strlcpy(newJob.name, json["name"] | "", sizeof(newJob.name));
-    int triggerType = json["type"] | 0;
-    newJob.type = static_cast<JobTrigger>(triggerType);
-    newJob.moisture_min = json["moisture_min"] | 20; // Default 20%
-    newJob.moisture_max = json["moisture_max"] | 80; // Default 80%
-    newJob.plant = json["plant"] | 0;
-    newJob.volume = json["volume"] | 0;
-    newJob.duration = json["duration"] | 0;
-    strlcpy(newJob.starttime, json["starttime"] | "", sizeof(newJob.starttime));
-    newJob.everyday = json["everyday"] | false;
+    if (!jobFromJson(json.as<JsonVariantConst>(), newJob)) {
+        return;
+    }
     joblistVec.push_back(newJob);
+    invalidateJobSchedule();
 
     logThrottled("Added job: %s", newJob.name);
 }
 
-void handleGetMoistureSensors() {
+// Start of a top level member's value, nested values and strings are skipped
+static const char* findJsonMember(const char* json, size_t length, const char* key) {
+    const char* end = json + length;
+    size_t keyLength = strlen(key);
+    int depth = 0;
+
+    for (const char* p = json; p < end; p++) {
+        if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+        } else if (*p == '"') {
+            const char* start = ++p;
+            while (p < end && *p != '"') {
+                if (*p == '\\') p++;
+                p++;
+            }
+            if (p >= end) return nullptr;
+            if (depth != 1 || (size_t)(p - start) != keyLength || memcmp(start, key, keyLength) != 0) continue;
+
+            const char* value = p + 1;
+            while (value < end && isspace((unsigned char)*value)) value++;
+            if (value < end && *value == ':') {
+                value++;
+                while (value < end && isspace((unsigned char)*value)) value++;
+                return value;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Parsed job list waiting for the loop task, which owns joblistVec
+static std::vector<jobStruct> pendingJobList;
+static bool jobListPending = false;
+
+// Replaces the whole job list, nothing changes unless every job parses
+void handleSetJobList(AsyncWebSocketClient *client, const WsIncoming& message) {
+    if (message.binary) {
+        logThrottled("setjoblist is only accepted as JSON text");
+        return;
+    }
+
+    const char* text = (const char*)message.data;
+    const char* array = findJsonMember(text, message.length, "joblist");
+    std::vector<jobStruct> jobs;
+    jobs.reserve(joblistVec.size());
+
+    if (array == nullptr || !jobListFromJson(array, text + message.length - array, jobs)) {
+        logThrottled("Invalid job list, keeping the current jobs");
+        handleGetJobList(client);
+        return;
+    }
+
+    WsLock lock(wsMutex);
+    pendingJobList.swap(jobs);
+    jobListPending = true;
+}
+
+// Installs a job list received by handleSetJobList.
+// Loop task only, the scheduler walks joblistVec without a lock.
+void applyPendingJobList() {
+    std::vector<jobStruct> jobs;
+    {
+        WsLock lock(wsMutex);
+        if (!jobListPending) return;
+        jobs.swap(pendingJobList);
+        jobListPending = false;
+    }
+
+    joblistVec.swap(jobs);
+    invalidateJobSchedule();
+    saveJobList(jobsfile);
+    logThrottled("Replaced job list with %u job(s)", (unsigned)joblistVec.size());
+
+    handleGetJobList(nullptr);
+}
+
+void handleGetMoistureSensors(AsyncWebSocketClient *client) {
     StaticJsonDocument<1024> doc;
     JsonArray sensorsArray = doc.createNestedArray("sensors");
 
@@ -175,10 +241,251 @@ void handleGetMoistureSensors() {
     doc["enabled"] = settings.use_moisturesensor;
     doc["count"] = sensors.size();
 
-    String response;
-    serializeJson(doc, response);
+    sendWsMessage(client, WS_TOPIC_MOISTURE, doc, WS_DELIVER_LATEST);
+}
+
+void handleGetCalibration(AsyncWebSocketClient *client) {
+    std::vector<MoistureSensorData> sensors = getMoistureSensorData();
+
+    const size_t capacity = JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(sensors.size()) +
+                           sensors.size() * (JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(MAX_CALIBRATION_POINTS) +
+                                             MAX_CALIBRATION_POINTS * JSON_ARRAY_SIZE(2)) +
+                           64;
+    DynamicJsonDocument doc(capacity);
+    doc["action"] = "setcalibration";
+    JsonArray sensorsArray = doc.createNestedArray("sensors");
 
-    ws.textAll(response);
+    for (size_t i = 0; i < sensors.size(); i++) {
+        JsonObject sensor = sensorsArray.createNestedObject();
+        sensor["id"] = i + 1;
+        sensor["raw"] = sensors[i].analogValue;
+
+        JsonArray points = sensor.createNestedArray("points");
+        if (i < settings.moisture_calibration.size()) {
+            for (const CalibrationPoint& point : settings.moisture_calibration[i]) {
+                JsonArray pair = points.createNestedArray();
+                pair.add(point.raw);
+                pair.add(point.percent);
+            }
+        }
+    }
+
+    sendWsMessage(client, WS_TOPIC_SETTINGS, doc, WS_DELIVER_LATEST);
+}
+
+// Store the current raw reading of a sensor as the given moisture percentage
+void handleCalibrationCapture(const JsonDocument& json) {
+    int sensorId = json["sensor"] | 0;
+    int percent = json["percent"] | -1;
+    if (sensorId < 1 || sensorId > (int)moistureSensors.size() || percent < 0 || percent > 100) {
+        logThrottled("Invalid calibration request");
+        return;
+    }
+
+    int raw = captureMoistureRaw(sensorId - 1);
+    if (settings.moisture_calibration.size() < moistureSensors.size()) {
+        settings.moisture_calibration.resize(moistureSensors.size());
+    }
+    if (!setCalibrationPoint(settings.moisture_calibration[sensorId - 1], raw, percent)) {
+        logThrottled("Sensor %d already has %d calibration points", sensorId, MAX_CALIBRATION_POINTS);
+        return;
+    }
+    logThrottled("Sensor %d calibrated: raw %d = %d%%", sensorId, raw, percent);
+
+    applyMoistureCalibration();
+    saveConfiguration(configfile);
+    handleGetCalibration(nullptr);
+}
+
+void handleCalibrationReset(const JsonDocument& json) {
+    int sensorId = json["sensor"] | 0;
+    if (sensorId < 1 || sensorId > (int)settings.moisture_calibration.size()) {
+        return;
+    }
+
+    settings.moisture_calibration[sensorId - 1].clear();
+    logThrottled("Sensor %d calibration reset", sensorId);
+
+    applyMoistureCalibration();
+    saveConfiguration(configfile);
+    handleGetCalibration(nullptr);
+}
+
+// Appends to out, only counts the length while out is null
+struct HistoryWriter {
+    uint8_t* out;
+    size_t capacity;
+    size_t length;
+
+    void bytes(const uint8_t* data, size_t n) {
+        if (out && length + n <= capacity) memcpy(out + length, data, n);
+        length += n;
+    }
+
+    void text(const char* format, ...) {
+        size_t room = (out && capacity > length) ? capacity - length : 0;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(out ? (char*)out + length : nullptr, room, format, args);
+        va_end(args);
+        if (n <= 0) return;
+        // Only what fit was written, the caller checks the length against the measured one
+        length += (out && (size_t)n >= room) ? (room > 0 ? room - 1 : 0) : n;
+    }
+
+    // MessagePack type byte followed by a big endian value of size bytes
+    void packed(uint8_t type, uint32_t value, uint8_t size) {
+        uint8_t data[5] = {type};
+        for (uint8_t i = 0; i < size; i++) {
+            data[1 + i] = value >> (8 * (size - 1 - i));
+        }
+        bytes(data, 1 + size);
+    }
+
+    void packUint(uint32_t value) {
+        if (value < 0x80) packed(value, 0, 0);
+        else if (value < 0x100) packed(0xcc, value, 1);
+        else if (value < 0x10000) packed(0xcd, value, 2);
+        else packed(0xce, value, 4);
+    }
+
+    void packString(const char* value) {
+        size_t n = strlen(value);
+        if (n < 32) packed(0xa0 | n, 0, 0);
+        else packed(0xd9, n, 1);
+        bytes((const uint8_t*)value, n);
+    }
+
+    void packArray(uint16_t count) {
+        if (count < 16) packed(0x90 | count, 0, 0);
+        else packed(0xdc, count, 2);
+    }
+};
+
+static void writeMoistureHistory(HistoryWriter& writer, const MoistureHistoryRange& range) {
+    writer.text("{\"action\":\"setmoisturehistory\",\"sensor\":%u,\"start\":%lu,\"step\":%lu,\"points\":[",
+                range.sensor + 1, (unsigned long)range.start, (unsigned long)range.step);
+    for (uint16_t i = 0; i < range.count; i++) {
+        MoistureAggregate point;
+        const char* separator = (i > 0) ? "," : "";
+        if (moistureHistoryPoint(range, i, point)) {
+            writer.text("%s[%u,%u,%u]", separator, point.min, point.max, point.mean);
+        } else {
+            writer.text("%snull", separator);
+        }
+    }
+    writer.text("]}");
+}
+
+// Same message as MessagePack for clients that negotiated it
+static void packMoistureHistory(HistoryWriter& writer, const MoistureHistoryRange& range) {
+    writer.packed(0x85, 0, 0);
+    writer.packString("action");
+    writer.packString("setmoisturehistory");
+    writer.packString("sensor");
+    writer.packUint(range.sensor + 1);
+    writer.packString("start");
+    writer.packUint((uint32_t)range.start);
+    writer.packString("step");
+    writer.packUint(range.step);
+    writer.packString("points");
+    writer.packArray(range.count);
+    for (uint16_t i = 0; i < range.count; i++) {
+        MoistureAggregate point;
+        if (moistureHistoryPoint(range, i, point)) {
+            writer.packArray(3);
+            writer.packUint(point.min);
+            writer.packUint(point.max);
+            writer.packUint(point.mean);
+        } else {
+            writer.packed(0xc0, 0, 0);
+        }
+    }
+}
+
+static AsyncWebSocketSharedBuffer moistureHistoryBuffer(const MoistureHistoryRange& range, bool msgpack) {
+    HistoryWriter measure = {nullptr, 0, 0};
+    if (msgpack) packMoistureHistory(measure, range);
+    else writeMoistureHistory(measure, range);
+
+    // Room for the terminator vsnprintf writes, the frame leaves it out
+    AsyncWebSocketSharedBuffer buffer = std::make_shared<std::vector<uint8_t>>(measure.length + 1);
+    HistoryWriter writer = {buffer->data(), buffer->size(), 0};
+    if (msgpack) packMoistureHistory(writer, range);
+    else writeMoistureHistory(writer, range);
+
+    if (writer.length != measure.length) {
+        logThrottled("Moisture history changed while writing, dropped");
+        return nullptr;
+    }
+    buffer->resize(writer.length);
+    return buffer;
+}
+
+// Range of min/max/mean points, written straight into one message buffer
+void handleGetMoistureHistory(AsyncWebSocketClient *client, const JsonDocument& json) {
+    int sensorId = json["sensor"] | 0;
+    time_t to = json["to"] | (long)clockTime();
+    time_t from = json["from"] | (long)(to - 86400);
+
+    MoistureHistoryRange range;
+    if (sensorId < 1 || !queryMoistureHistory(sensorId - 1, from, to, range)) {
+        range = {(uint8_t)(sensorId > 0 ? sensorId - 1 : 0), 0, from, 60, 0};
+    }
+
+    bool msgpack = clientFormat(client->id()) == WS_FORMAT_MSGPACK;
+    AsyncWebSocketSharedBuffer buffer = moistureHistoryBuffer(range, msgpack);
+    if (!buffer) return;
+
+    WsMessage message(msgpack ? nullptr : buffer, msgpack ? buffer : nullptr);
+    sendWsMessage(client, WS_TOPIC_MOISTURE, message);
+}
+
+void sendFlowAlert(const char* type, int plant, int rate, int expected) {
+    StaticJsonDocument<JSON_OBJECT_SIZE(5)> doc;
+    doc["action"] = "flowalert";
+    doc["type"] = type;
+    doc["plant"] = plant;
+    doc["rate"] = rate;
+    doc["expected"] = expected;
+
+    sendWsMessage(nullptr, WS_TOPIC_STATE, doc);
+}
+
+void handleGetWsStats(AsyncWebSocketClient *client) {
+    std::vector<WsClientStats> stats = getWsClientStats();
+
+    const size_t capacity = JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(stats.size()) +
+                           stats.size() * JSON_OBJECT_SIZE(6);
+    DynamicJsonDocument doc(capacity);
+    doc["action"] = "setwsstats";
+    JsonArray clients = doc.createNestedArray("clients");
+
+    for (const WsClientStats& entry : stats) {
+        JsonObject obj = clients.createNestedObject();
+        obj["id"] = entry.id;
+        obj["queued"] = entry.queued;
+        obj["pending"] = entry.pending;
+        obj["deferred"] = entry.deferred;
+        obj["coalesced"] = entry.coalesced;
+        obj["dropped"] = entry.dropped;
+    }
+
+    sendWsMessage(client, WS_TOPIC_STATE, doc);
+}
+
+// Forwards log lines to clients subscribed to the logs topic
+static void sendLogLine(const char* message) {
+    static bool sending = false;
+    if (sending) return;
+    sending = true;
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(2)> doc;
+    doc["action"] = "log";
+    doc["message"] = message;
+    sendWsMessage(nullptr, WS_TOPIC_LOGS, doc);
+
+    sending = false;
 }
 
 void handleAutoSwitch() {
@@ -188,58 +495,158 @@ void handleAutoSwitch() {
 }
 
 void handleResetCounter() {
-    extern volatile int pulseCount;
-    extern float soilFlowRate;
-    extern float soilFlowVolume;
-    extern float roundSoilFlowVolume;
-    extern float tempsoilFlowVolume;
-    
-    pulseCount = 0;
-    soilFlowRate = 0.0;
-    soilFlowVolume = 0.0;
-    roundSoilFlowVolume = 0.0;
-    tempsoilFlowVolume = 0.0;
+    resetFlowVolume();
     pumpRunTime = 0;
     pumpStartMillis = 0;
     
     notifyClients();
 }
 
-void handleWebSocketMessage(void *arg, uint8_t *data, size_t len) {
-    AwsFrameInfo *info = (AwsFrameInfo*)arg;
+// Action handlers, all take the sending client and the decoded payload
+typedef void (*WsActionHandler)(AsyncWebSocketClient* client, const JsonDocument& json);
+// Handlers of bulk payloads parse the raw message themselves
+typedef void (*WsStreamHandler)(AsyncWebSocketClient* client, const WsIncoming& message);
 
-    if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
-        const size_t size = JSON_OBJECT_SIZE(11) + 256;
-        StaticJsonDocument<size> json;
-        DeserializationError err = deserializeJson(json, data);
+static void actionHello(AsyncWebSocketClient* client, const JsonDocument& json) {
+    bool msgpack = strcmp(json["format"] | "json", "msgpack") == 0;
+    setClientFormat(client->id(), msgpack ? WS_FORMAT_MSGPACK : WS_FORMAT_JSON);
+}
 
-        if (err) {
-            logThrottled("deserializeJson() failed: %s", err.c_str());
-            return;
-        }
+static void actionSubscribe(AsyncWebSocketClient* client, const JsonDocument& json) {
+    setClientTopics(client->id(), topicsFromJson(json["topics"]));
+    if (clientTopics(client->id()) & WS_TOPIC_STATE) queueStateSnapshot(client->id());
+    else forgetStateClient(client->id());
+}
 
-        const char* tmpAct = json["action"] | "";
-        String action = String(tmpAct);
-        logThrottled("action: %s", action.c_str());
-
-        if (action == "getvalues") handleGetData();
-        else if (action == "getsettings") handleGetSettings();
-        else if (action == "getjoblist") handleGetJobList();
-        else if (action == "savesettings") handleSaveSettings(json);
-        else if (action == "addjobtolist") handleAddJobToList(json);
-        else if (action == "savejoblist") saveJobList(jobsfile);
-        else if (action == "deletejoblist") deleteJobList(jobsfile);
-        else if (action == "resetcounter") handleResetCounter();
-        else if (action == "getmoisturesensors") handleGetMoistureSensors();
-        else if (action == "auto_switch") handleAutoSwitch();
-        else if (action == "pump_switch") handlePumpSwitch(true);
-        else if (action == "valve_switch") {
-            int valveId = json["valve_id"].as<int>();
-            if (valveId > 0 && valveId <= settings.plant_count) {
-                handleValveSwitch(valveId - 1);
-            }
-        }
+static void actionAck(AsyncWebSocketClient* client, const JsonDocument& json) {
+    handleStateAck(client, json["v"] | 0);
+}
+
+static void actionValveSwitch(AsyncWebSocketClient* client, const JsonDocument& json) {
+    int valveId = json["valve_id"] | 0;
+    if (valveId > 0 && valveId <= settings.plant_count) {
+        handleValveSwitch(valveId - 1);
+    }
+}
+
+static void actionGetWsStats(AsyncWebSocketClient* client, const JsonDocument& json) { handleGetWsStats(client); }
+static void actionGetValues(AsyncWebSocketClient* client, const JsonDocument& json) { sendStateSnapshot(client); }
+static void actionGetSettings(AsyncWebSocketClient* client, const JsonDocument& json) { handleGetSettings(client); }
+static void actionSaveSettings(AsyncWebSocketClient* client, const JsonDocument& json) { handleSaveSettings(json); }
+static void actionGetJobList(AsyncWebSocketClient* client, const JsonDocument& json) { handleGetJobList(client); }
+static void actionAddJobToList(AsyncWebSocketClient* client, const JsonDocument& json) { handleAddJobToList(json); }
+static void actionSaveJobList(AsyncWebSocketClient* client, const JsonDocument& json) { saveJobList(jobsfile); }
+static void actionDeleteJobList(AsyncWebSocketClient* client, const JsonDocument& json) { deleteJobList(jobsfile); }
+static void actionResetCounter(AsyncWebSocketClient* client, const JsonDocument& json) { handleResetCounter(); }
+static void actionGetMoistureSensors(AsyncWebSocketClient* client, const JsonDocument& json) { handleGetMoistureSensors(client); }
+static void actionGetCalibration(AsyncWebSocketClient* client, const JsonDocument& json) { handleGetCalibration(client); }
+static void actionGetMoistureHistory(AsyncWebSocketClient* client, const JsonDocument& json) { handleGetMoistureHistory(client, json); }
+static void actionCalibrateCapture(AsyncWebSocketClient* client, const JsonDocument& json) { handleCalibrationCapture(json); }
+static void actionCalibrateReset(AsyncWebSocketClient* client, const JsonDocument& json) { handleCalibrationReset(json); }
+static void actionAutoSwitch(AsyncWebSocketClient* client, const JsonDocument& json) { handleAutoSwitch(); }
+static void actionPumpSwitch(AsyncWebSocketClient* client, const JsonDocument& json) { handlePumpSwitch(true); }
+
+// Each action declares the document capacity its payload needs, or streams it
+struct WsAction {
+    const char* name;
+    WsActionHandler handler;
+    size_t capacity;
+    WsStreamHandler stream;
+};
+
+// Sorted by name for the binary search, checked at compile time
+static constexpr WsAction wsActions[] = {
+    {"ack", actionAck, JSON_OBJECT_SIZE(2)},
+    {"addjobtolist", actionAddJobToList, JSON_OBJECT_SIZE(13)},
+    {"auto_switch", actionAutoSwitch, JSON_OBJECT_SIZE(2)},
+    {"calibrate_capture", actionCalibrateCapture, JSON_OBJECT_SIZE(3)},
+    {"calibrate_reset", actionCalibrateReset, JSON_OBJECT_SIZE(2)},
+    {"deletejoblist", actionDeleteJobList, JSON_OBJECT_SIZE(1)},
+    {"getcalibration", actionGetCalibration, JSON_OBJECT_SIZE(1)},
+    {"getjoblist", actionGetJobList, JSON_OBJECT_SIZE(1)},
+    {"getmoisturehistory", actionGetMoistureHistory, JSON_OBJECT_SIZE(4)},
+    {"getmoisturesensors", actionGetMoistureSensors, JSON_OBJECT_SIZE(1)},
+    {"getsettings", actionGetSettings, JSON_OBJECT_SIZE(1)},
+    {"getvalues", actionGetValues, JSON_OBJECT_SIZE(1)},
+    {"getwsstats", actionGetWsStats, JSON_OBJECT_SIZE(1)},
+    {"hello", actionHello, JSON_OBJECT_SIZE(2)},
+    {"pump_switch", actionPumpSwitch, JSON_OBJECT_SIZE(2)},
+    {"resetcounter", actionResetCounter, JSON_OBJECT_SIZE(1)},
+    {"savejoblist", actionSaveJobList, JSON_OBJECT_SIZE(1)},
+    {"savesettings", actionSaveSettings, JSON_OBJECT_SIZE(11) + JSON_ARRAY_SIZE(MAX_PLANTS)},
+    {"setjoblist", nullptr, 0, handleSetJobList},
+    {"subscribe", actionSubscribe, JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(5)},
+    {"valve_switch", actionValveSwitch, JSON_OBJECT_SIZE(2)},
+};
+
+static constexpr size_t WS_ACTION_COUNT = sizeof(wsActions) / sizeof(wsActions[0]);
+
+// Single return constexpr helpers, the 2.x core still compiles as C++11
+static constexpr int compareNames(const char* a, const char* b) {
+    return (*a != *b || *a == '\0') ? *a - *b : compareNames(a + 1, b + 1);
+}
+
+static constexpr bool actionsSorted(size_t i) {
+    return i >= WS_ACTION_COUNT ||
+           (compareNames(wsActions[i - 1].name, wsActions[i].name) < 0 && actionsSorted(i + 1));
+}
+
+static constexpr size_t largestActionCapacity(size_t i) {
+    return i >= WS_ACTION_COUNT ? 0 :
+           (wsActions[i].capacity > largestActionCapacity(i + 1) ? wsActions[i].capacity
+                                                                 : largestActionCapacity(i + 1));
+}
+
+static_assert(actionsSorted(1), "wsActions must be sorted by name");
+
+// Strings stay in the frame buffer, the pool only holds the payload structure
+static constexpr size_t WS_ACTION_CAPACITY = largestActionCapacity(0);
+
+static const WsAction* findAction(const char* name) {
+    size_t low = 0;
+    size_t high = WS_ACTION_COUNT;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        int order = strcmp(name, wsActions[mid].name);
+        if (order == 0) return &wsActions[mid];
+        if (order < 0) high = mid;
+        else low = mid + 1;
+    }
+    return nullptr;
+}
+
+static void dispatchWsMessage(AsyncWebSocketClient *client, const WsIncoming& message) {
+    char name[24];
+    if (!readWsAction(message, name, sizeof(name))) return;
+
+    const WsAction* action = findAction(name);
+    logThrottled("action: %s", name);
+
+    if (action == nullptr) {
+        logThrottled("Unknown action: %s", name);
+        return;
     }
+    if (action->stream) {
+        action->stream(client, message);
+        return;
+    }
+
+    StaticJsonDocument<WS_ACTION_CAPACITY> json;
+    if (!decodeWsMessage(message, json)) return;
+
+    if (json.memoryUsage() > action->capacity) {
+        logThrottled("Payload of %s exceeds its declared size", name);
+        return;
+    }
+    action->handler(client, json);
+}
+
+void handleWebSocketMessage(AsyncWebSocketClient *client, void *arg, uint8_t *data, size_t len) {
+    WsIncoming message;
+    if (!assembleWsMessage(client->id(), (AwsFrameInfo*)arg, data, len, message)) return;
+
+    dispatchWsMessage(client, message);
+    releaseWsMessage(client->id());
 }
 
 void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
@@ -247,12 +654,16 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventTyp
         case WS_EVT_CONNECT:
             logThrottled("WebSocket client #%u connected from %s", 
                 client->id(), client->remoteIP().toString().c_str());
+            trackWsClient(client->id());
+            queueStateSnapshot(client->id());
             break;
         case WS_EVT_DISCONNECT:
             logThrottled("WebSocket client #%u disconnected", client->id());
+            forgetStateClient(client->id());
+            forgetWsClient(client->id());
             break;
         case WS_EVT_DATA:
-            handleWebSocketMessage(arg, data, len);
+            handleWebSocketMessage(client, arg, data, len);
             break;
         case WS_EVT_ERROR:
             logThrottled("WebSocket error: client #%u", client->id());
@@ -264,4 +675,5 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventTyp
 
 void initWebSocket() {
     ws.onEvent(onWsEvent);
+    setLogListener(sendLogLine);
 }
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include "network/ws_protocol.h"
+#include "network/websocket_handler.h"
+#include "config.h"
+#include "utils/logger.h"
+#include <vector>
+
+static const uint8_t WS_TOPIC_COUNT = 5;
+
+std::recursive_mutex wsMutex;
+
+// Message held back until the client's queue has room, in the client's format
+struct WsPending {
+    uint8_t topic;
+    uint32_t key;  // Action hash of a WS_DELIVER_LATEST broadcast, 0 for the rest
+    AsyncWebSocketSharedBuffer buffer;
+};
+
+// Connected clients, any without an entry get JSON on the default topics
+struct WsClientInfo {
+    uint32_t id;
+    WsFormat format;
+    uint8_t topics;
+    uint32_t deferred;
+    uint32_t coalesced;
+    uint32_t dropped;
+    uint8_t pendingCount;
+    WsPending pending[WS_CLIENT_PENDING_MAX];  // Oldest first
+};
+
+static WsClientInfo wsClients[MAX_WS_CLIENTS];
+static uint8_t wsClientCount = 0;
+
+// Messages split over several frames or TCP segments, collected until complete
+struct WsAssembly {
+    uint32_t clientId;
+    bool used;
+    bool binary;
+    std::vector<uint8_t> data;
+};
+
+static WsAssembly wsAssemblies[MAX_WS_CLIENTS];
+
+static const char* const topicNames[WS_TOPIC_COUNT] = {"state", "settings", "jobs", "moisture", "logs"};
+
+// Moves the last entry into the gap and frees its held back buffers
+static void removeWsClient(uint8_t index) {
+    wsClientCount--;
+    if (index != wsClientCount) wsClients[index] = wsClients[wsClientCount];
+    wsClients[wsClientCount] = WsClientInfo();
+}
+
+// Drop entries of clients that went away
+static void pruneWsClients() {
+    for (uint8_t i = wsClientCount; i > 0; i--) {
+        if (ws.client(wsClients[i - 1].id) == nullptr) removeWsClient(i - 1);
+    }
+}
+
+static WsClientInfo* findWsClient(uint32_t clientId, bool create) {
+    for (uint8_t i = 0; i < wsClientCount; i++) {
+        if (wsClients[i].id == clientId) return &wsClients[i];
+    }
+    if (!create) return nullptr;
+
+    if (wsClientCount == MAX_WS_CLIENTS) pruneWsClients();
+    if (wsClientCount == MAX_WS_CLIENTS) {
+        logThrottled("No protocol slot for client #%u, using defaults", clientId);
+        return nullptr;
+    }
+    WsClientInfo& info = wsClients[wsClientCount++];
+    info = WsClientInfo();
+    info.id = clientId;
+    info.format = WS_FORMAT_JSON;
+    info.topics = WS_TOPIC_DEFAULT;
+    return &info;
+}
+
+void setClientFormat(uint32_t clientId, WsFormat format) {
+    WsLock lock(wsMutex);
+    WsClientInfo* info = findWsClient(clientId, true);
+    if (info) info->format = format;
+}
+
+WsFormat clientFormat(uint32_t clientId) {
+    WsLock lock(wsMutex);
+    const WsClientInfo* info = findWsClient(clientId, false);
+    return info ? info->format : WS_FORMAT_JSON;
+}
+
+void setClientTopics(uint32_t clientId, uint8_t topics) {
+    WsLock lock(wsMutex);
+    WsClientInfo* info = findWsClient(clientId, true);
+    if (info) info->topics = topics;
+}
+
+uint8_t clientTopics(uint32_t clientId) {
+    WsLock lock(wsMutex);
+    const WsClientInfo* info = findWsClient(clientId, false);
+    return info ? info->topics : WS_TOPIC_DEFAULT;
+}
+
+uint8_t topicsFromJson(JsonVariantConst names) {
+    uint8_t topics = 0;
+    for (JsonVariantConst name : names.as<JsonArrayConst>()) {
+        for (uint8_t i = 0; i < WS_TOPIC_COUNT; i++) {
+            if (strcmp(name | "", topicNames[i]) == 0) topics |= 1 << i;
+        }
+    }
+    return topics;
+}
+
+void trackWsClient(uint32_t clientId) {
+    WsLock lock(wsMutex);
+    findWsClient(clientId, true);
+}
+
+void forgetWsClient(uint32_t clientId) {
+    WsLock lock(wsMutex);
+    WsClientInfo* info = findWsClient(clientId, false);
+    if (info) removeWsClient(info - wsClients);
+    releaseWsMessage(clientId);
+}
+
+static bool clientCongested(AsyncWebSocketClient* client) {
+    return client->queueLen() >= WS_CLIENT_QUEUE_DEPTH || !client->canSend();
+}
+
+// For senders that catch up on their own, like the state deltas
+bool wsClientReady(AsyncWebSocketClient* client) {
+    WsLock lock(wsMutex);
+    if (!clientCongested(client)) return true;
+
+    WsClientInfo* info = findWsClient(client->id(), false);
+    if (info) info->deferred++;
+    return false;
+}
+
+// Drops the first count held back messages, the rest moves up
+static void removePending(WsClientInfo& info, uint8_t index, uint8_t count) {
+    for (uint8_t i = index; i + count < info.pendingCount; i++) {
+        info.pending[i] = info.pending[i + count];
+    }
+    for (uint8_t i = info.pendingCount - count; i < info.pendingCount; i++) {
+        info.pending[i] = WsPending();
+    }
+    info.pendingCount -= count;
+}
+
+// Sends now, or holds the message back behind the older ones.
+// A newer broadcast with the same key replaces the held back one.
+static void queueWsMessage(AsyncWebSocketClient* client, uint8_t topic, uint32_t key, WsMessage& message) {
+    WsClientInfo* info = findWsClient(client->id(), false);
+    if (info == nullptr) {
+        message.send(client);
+        return;
+    }
+
+    for (uint8_t i = 0; key != 0 && i < info->pendingCount; i++) {
+        if (info->pending[i].key == key && info->pending[i].topic == topic) {
+            removePending(*info, i, 1);
+            info->coalesced++;
+            break;
+        }
+    }
+    if (info->pendingCount == 0 && !clientCongested(client)) {
+        message.send(client);
+        return;
+    }
+
+    AsyncWebSocketSharedBuffer buffer = (info->format == WS_FORMAT_MSGPACK) ? message.packedBuffer() : message.jsonBuffer();
+    if (!buffer) return;
+    if (info->pendingCount == WS_CLIENT_PENDING_MAX) {
+        info->dropped++;
+        return;
+    }
+    info->pending[info->pendingCount++] = {topic, key, buffer};
+    info->deferred++;
+}
+
+// Sends held back messages in order while the client's queue has room
+void flushWsQueues() {
+    WsLock lock(wsMutex);
+    for (uint8_t i = 0; i < wsClientCount; i++) {
+        WsClientInfo& info = wsClients[i];
+        AsyncWebSocketClient* client = ws.client(info.id);
+        if (client == nullptr) continue;
+
+        uint8_t sent = 0;
+        while (sent < info.pendingCount && !clientCongested(client)) {
+            const AsyncWebSocketSharedBuffer& buffer = info.pending[sent++].buffer;
+            if (info.format == WS_FORMAT_MSGPACK) client->binary(buffer);
+            else client->text(buffer);
+        }
+        if (sent > 0) removePending(info, 0, sent);
+    }
+}
+
+std::vector<WsClientStats> getWsClientStats() {
+    WsLock lock(wsMutex);
+    std::vector<WsClientStats> stats;
+    for (uint8_t i = 0; i < wsClientCount; i++) {
+        const WsClientInfo& info = wsClients[i];
+        AsyncWebSocketClient* client = ws.client(info.id);
+
+        stats.push_back({info.id, client ? client->queueLen() : 0, info.pendingCount,
+                         info.deferred, info.coalesced, info.dropped});
+    }
+    return stats;
+}
+
+// The writers reserve a byte for a terminator, the frame leaves it out
+AsyncWebSocketSharedBuffer WsMessage::jsonBuffer() {
+    if (!json && doc) {
+        size_t length = measureJson(*doc);
+        json = std::make_shared<std::vector<uint8_t>>(length + 1);
+        serializeJson(*doc, (char*)json->data(), json->size());
+        json->resize(length);
+    }
+    return json;
+}
+
+AsyncWebSocketSharedBuffer WsMessage::packedBuffer() {
+    if (!packed && doc) {
+        size_t length = measureMsgPack(*doc);
+        packed = std::make_shared<std::vector<uint8_t>>(length + 1);
+        serializeMsgPack(*doc, packed->data(), packed->size());
+        packed->resize(length);
+    }
+    return packed;
+}
+
+void WsMessage::send(AsyncWebSocketClient* client) {
+    if (clientFormat(client->id()) == WS_FORMAT_MSGPACK) {
+        AsyncWebSocketSharedBuffer buffer = packedBuffer();
+        if (buffer) client->binary(buffer);
+    } else {
+        AsyncWebSocketSharedBuffer buffer = jsonBuffer();
+        if (buffer) client->text(buffer);
+    }
+}
+
+// Buffers the caller wrote are kept, there is nothing to rebuild them from
+void WsMessage::clear() {
+    if (doc == nullptr) return;
+    json.reset();
+    packed.reset();
+}
+
+static WsAssembly* findAssembly(uint32_t clientId, bool create) {
+    WsAssembly* freeSlot = nullptr;
+    for (WsAssembly& assembly : wsAssemblies) {
+        if (assembly.used && assembly.clientId == clientId) return &assembly;
+        if (!assembly.used && !freeSlot) freeSlot = &assembly;
+    }
+    if (!create) return nullptr;
+
+    // Slots of clients that went away without a disconnect event
+    if (!freeSlot) {
+        for (WsAssembly& assembly : wsAssemblies) {
+            if (ws.client(assembly.clientId) == nullptr) {
+                freeSlot = &assembly;
+                break;
+            }
+        }
+    }
+    if (freeSlot) {
+        freeSlot->clientId = clientId;
+        freeSlot->used = true;
+        freeSlot->data.clear();
+    }
+    return freeSlot;
+}
+
+// True once the last chunk of a message arrived, a single chunk message stays in place
+bool assembleWsMessage(uint32_t clientId, const AwsFrameInfo* info, uint8_t* data, size_t len, WsIncoming& message) {
+    bool first = info->num == 0 && info->index == 0;
+
+    if (first && info->final && info->len == len) {
+        if (info->opcode != WS_TEXT && info->opcode != WS_BINARY) return false;
+        message = {data, len, info->opcode == WS_BINARY};
+        return true;
+    }
+
+    // Continuations of a message that was dropped or never started are ignored
+    WsAssembly* assembly = findAssembly(clientId, first);
+    if (assembly == nullptr) return false;
+
+    if (first) {
+        assembly->binary = info->opcode == WS_BINARY;
+        assembly->data.clear();
+        assembly->data.reserve(info->len < WS_MESSAGE_MAX_BYTES ? info->len : WS_MESSAGE_MAX_BYTES);
+    }
+    if (assembly->data.size() + len > WS_MESSAGE_MAX_BYTES) {
+        logThrottled("Message from client #%u exceeds %u bytes, dropped", clientId, (unsigned)WS_MESSAGE_MAX_BYTES);
+        releaseWsMessage(clientId);
+        return false;
+    }
+    assembly->data.insert(assembly->data.end(), data, data + len);
+
+    if (!info->final || info->index + len < info->len) return false;
+    message = {assembly->data.data(), assembly->data.size(), assembly->binary};
+    return true;
+}
+
+void releaseWsMessage(uint32_t clientId) {
+    WsAssembly* assembly = findAssembly(clientId, false);
+    if (assembly == nullptr) return;
+
+    std::vector<uint8_t>().swap(assembly->data);
+    assembly->used = false;
+}
+
+// Reads only the action, leaves the message untouched for the real decoding
+bool readWsAction(const WsIncoming& message, char* name, size_t size) {
+    StaticJsonDocument<JSON_OBJECT_SIZE(1)> filter;
+    filter["action"] = true;
+    StaticJsonDocument<JSON_OBJECT_SIZE(1) + 32> doc;
+
+    DeserializationError err;
+    if (message.binary) {
+        err = deserializeMsgPack(doc, (const char*)message.data, message.length, DeserializationOption::Filter(filter));
+    } else {
+        err = deserializeJson(doc, (const char*)message.data, message.length, DeserializationOption::Filter(filter));
+    }
+
+    if (err) {
+        logThrottled("WebSocket message decoding failed: %s", err.c_str());
+        return false;
+    }
+    strlcpy(name, doc["action"] | "", size);
+    return true;
+}
+
+// Text frames carry JSON, binary frames MessagePack, both decoded in place
+bool decodeWsMessage(const WsIncoming& message, JsonDocument& doc) {
+    DeserializationError err;
+    if (message.binary) {
+        err = deserializeMsgPack(doc, (char*)message.data, message.length);
+    } else {
+        err = deserializeJson(doc, (char*)message.data, message.length);
+    }
+
+    if (err) {
+        logThrottled("WebSocket message decoding failed: %s", err.c_str());
+        return false;
+    }
+    return true;
+}
+
+// FNV-1a, never 0 so it can't be mistaken for a message that must not be replaced
+static uint32_t actionKey(const char* action) {
+    uint32_t hash = 2166136261u;
+    for (const char* p = action; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// Reply to the requesting client, or publish to the topic's subscribers
+static void publishWsMessage(AsyncWebSocketClient* client, uint8_t topic, uint32_t key, WsMessage& message) {
+    WsLock lock(wsMutex);
+
+    if (client != nullptr) {
+        queueWsMessage(client, topic, 0, message);
+        return;
+    }
+    if (wsClientCount == 0) {
+        if (!(topic & WS_TOPIC_DEFAULT)) return;
+        AsyncWebSocketSharedBuffer buffer = message.jsonBuffer();
+        if (buffer) ws.textAll(buffer);
+        return;
+    }
+
+    // The library's client list changes on the async_tcp task, walk our own table
+    for (uint8_t i = 0; i < wsClientCount; i++) {
+        if (!(wsClients[i].topics & topic)) continue;
+
+        AsyncWebSocketClient* subscriber = ws.client(wsClients[i].id);
+        if (subscriber != nullptr && subscriber->status() == WS_CONNECTED) {
+            queueWsMessage(subscriber, topic, key, message);
+        }
+    }
+}
+
+// Replies are never replaced, whatever the delivery
+void sendWsMessage(AsyncWebSocketClient* client, uint8_t topic, const JsonDocument& doc, WsDelivery delivery) {
+    WsMessage message(doc);
+    uint32_t key = (delivery == WS_DELIVER_LATEST) ? actionKey(doc["action"] | "") : 0;
+    publishWsMessage(client, topic, key, message);
+}
+
+void sendWsMessage(AsyncWebSocketClient* client, uint8_t topic, WsMessage& message) {
+    publishWsMessage(client, topic, 0, message);
+}
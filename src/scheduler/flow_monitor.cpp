@@ -0,0 +1,120 @@
+#include "scheduler/flow_monitor.h"
+#include "scheduler/job_state_machine.h"
+#include "network/websocket_handler.h"
+#include "utils/clock.h"
+#include "utils/logger.h"
+
+// Learned flow of one valve running alone, EMA in ml/min << 8
+struct ValveFlow {
+    int32_t emaQ8;
+    uint8_t samples;
+};
+
+static std::vector<ValveFlow> valveFlows;
+static FlowAnomaly suspected = FLOW_OK;
+static uint8_t suspectCount = 0;
+// Open valves at the last sample, flow needs time to settle after any change
+static uint32_t openValveMask = UINT32_MAX;
+static uint32_t valvesChangedAt = 0;
+
+const char* flowAnomalyName(FlowAnomaly anomaly) {
+    switch (anomaly) {
+        case FLOW_DRY_RUN: return "dry_run";
+        case FLOW_LEAK: return "leak";
+        case FLOW_DRIFT: return "drift";
+        default: return "ok";
+    }
+}
+
+int learnedValveFlow(size_t plant) {
+    if (plant >= valveFlows.size() || valveFlows[plant].samples < FLOW_LEARN_SAMPLES) {
+        return 0;
+    }
+    return valveFlows[plant].emaQ8 >> 8;
+}
+
+static void learnValveFlow(ValveFlow& valve, int rate) {
+    if (valve.samples == 0) {
+        valve.emaQ8 = rate << 8;
+    } else {
+        valve.emaQ8 += ((rate << 8) - valve.emaQ8) >> FLOW_LEARN_SHIFT;
+    }
+    if (valve.samples < 255) valve.samples++;
+}
+
+// Single open valve, -2 if several are open, -1 if none
+static int openValve(uint32_t& mask) {
+    int open = -1;
+    mask = 0;
+    for (uint8_t i = 0; i < settings.plant_count && i < valveStates.size(); i++) {
+        if (valveStates[i] != HIGH) continue;
+        mask |= 1UL << i;
+        open = (open == -1) ? i : -2;
+    }
+    return open;
+}
+
+static FlowAnomaly classifySample(int rate, uint32_t now, int& plant, int& expected) {
+    uint32_t mask;
+    plant = openValve(mask);
+    expected = 0;
+
+    // A handoff or one of several zones stopping changes the flow while the pump keeps running
+    if (mask != openValveMask) {
+        openValveMask = mask;
+        valvesChangedAt = now;
+    }
+    bool valvesSettled = now - valvesChangedAt >= FLOW_SETTLE_TIME;
+
+    if (plant == -1) {
+        return (valvesSettled && rate >= FLOW_MIN_RATE) ? FLOW_LEAK : FLOW_OK;
+    }
+
+    if (pumpCtx.state != PUMP_RUNNING || now - pumpStartMillis < FLOW_SETTLE_TIME || !valvesSettled) {
+        return FLOW_OK;
+    }
+    if (rate < FLOW_MIN_RATE) {
+        return FLOW_DRY_RUN;
+    }
+    if (plant < 0) {
+        return FLOW_OK;
+    }
+
+    if (valveFlows.size() < settings.plant_count) {
+        valveFlows.resize(settings.plant_count, {0, 0});
+    }
+    ValveFlow& valve = valveFlows[plant];
+    expected = learnedValveFlow(plant);
+    if (expected > 0 && abs(rate - expected) * 100 > expected * FLOW_DRIFT_PERCENT) {
+        return FLOW_DRIFT;
+    }
+
+    learnValveFlow(valve, rate);
+    return FLOW_OK;
+}
+
+// Flow listener, one constant time check per rate update
+void handleFlowSample(float litersPerMinute) {
+    if (!settings.use_flowsensor) return;
+
+    uint32_t now = clockMillis();
+    int rate = (int)(litersPerMinute * 1000.0f + 0.5f);
+    int plant;
+    int expected;
+    FlowAnomaly anomaly = classifySample(rate, now, plant, expected);
+
+    if (anomaly == FLOW_OK || anomaly != suspected) {
+        suspected = anomaly;
+        suspectCount = (anomaly == FLOW_OK) ? 0 : 1;
+    } else if (suspectCount < 255) {
+        suspectCount++;
+    }
+    if (anomaly == FLOW_OK || suspectCount != FLOW_ANOMALY_SAMPLES) {
+        return;
+    }
+
+    logThrottled("Flow anomaly %s: %d ml/min, expected %d ml/min, valve %d",
+                 flowAnomalyName(anomaly), rate, expected, plant + 1);
+    abortJobs(flowAnomalyName(anomaly));
+    sendFlowAlert(flowAnomalyName(anomaly), plant >= 0 ? plant + 1 : 0, rate, expected);
+}
@@ -1,5 +1,7 @@
 #include "scheduler/job_parser.h"
+#include "scheduler/job_schedule.h"
 #include "utils/logger.h"
+#include <ctype.h>
 
 jobDateTime parseJobDateTime(const char* starttime) {
     jobDateTime dt = {0,0,0,0,0,false,false};
@@ -51,4 +53,197 @@ jobDateTime parseJobDateTime(const char* starttime) {
 
     logThrottled("Failed to parse datetime: %s", starttime);
     return dt;
-}
\ No newline at end of file
+}
+
+static const size_t CRON_FIELDS = 5;
+static const size_t CRON_FIELD_SIZE = sizeof(((jobStruct*)nullptr)->cron);
+
+// Reads the digits at p and moves past them, anything else is an error
+static bool parseCronNumber(const char*& p, int& value) {
+    if (!isdigit((unsigned char)*p)) return false;
+    value = 0;
+    while (isdigit((unsigned char)*p)) {
+        if (value > 100) return false;
+        value = value * 10 + (*p++ - '0');
+    }
+    return true;
+}
+
+// Parse one cron field ("*", "5", "1-5", "*/4", "8-18/2" or lists of these)
+static bool parseCronField(const char* field, int minVal, int maxVal, uint64_t& bits) {
+    char buf[CRON_FIELD_SIZE];
+    char* saveptr = nullptr;
+    bits = 0;
+
+    // strtok_r would skip empty list entries
+    size_t length = strlen(field);
+    if (length >= sizeof(buf) || field[0] == ',' || field[length - 1] == ',' || strstr(field, ",,")) return false;
+
+    strlcpy(buf, field, sizeof(buf));
+    for (char* tok = strtok_r(buf, ",", &saveptr); tok != nullptr; tok = strtok_r(nullptr, ",", &saveptr)) {
+        int lo = minVal, hi = maxVal, step = 1;
+
+        char* slash = strchr(tok, '/');
+        if (slash != nullptr) {
+            *slash = '\0';
+            const char* p = slash + 1;
+            if (!parseCronNumber(p, step) || *p != '\0' || step <= 0) return false;
+        }
+
+        if (strcmp(tok, "*") != 0) {
+            const char* p = tok;
+            if (!parseCronNumber(p, lo)) return false;
+            if (*p == '-') {
+                p++;
+                if (!parseCronNumber(p, hi)) return false;
+            } else {
+                // "5/15" runs from 5 to the end of the range
+                hi = (slash != nullptr) ? maxVal : lo;
+            }
+            if (*p != '\0') return false;
+        }
+
+        if (lo < minVal || hi > maxVal || lo > hi) return false;
+
+        for (int v = lo; v <= hi; v += step) {
+            bits |= 1ULL << v;
+        }
+    }
+
+    return bits != 0;
+}
+
+CronSpec parseCronExpression(const char* expr) {
+    CronSpec spec = {0, 0, 0, 0, 0, false, false, false};
+    if (expr == nullptr || expr[0] == '\0') return spec;
+
+    // Exactly five whitespace separated fields, none of them cut short
+    char fields[CRON_FIELDS][CRON_FIELD_SIZE];
+    size_t count = 0;
+    for (const char* p = expr;;) {
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0') break;
+
+        const char* start = p;
+        while (*p != '\0' && !isspace((unsigned char)*p)) p++;
+        size_t length = p - start;
+        if (count == CRON_FIELDS || length >= CRON_FIELD_SIZE) {
+            count = 0;
+            break;
+        }
+        memcpy(fields[count], start, length);
+        fields[count++][length] = '\0';
+    }
+    if (count != CRON_FIELDS) {
+        logThrottled("Failed to parse cron expression: %s", expr);
+        return spec;
+    }
+    const char* minute = fields[0];
+    const char* hour = fields[1];
+    const char* day = fields[2];
+    const char* month = fields[3];
+    const char* weekday = fields[4];
+
+    uint64_t minutes, hours, days, months, weekdays;
+    if (!parseCronField(minute, 0, 59, minutes) ||
+        !parseCronField(hour, 0, 23, hours) ||
+        !parseCronField(day, 1, 31, days) ||
+        !parseCronField(month, 1, 12, months) ||
+        !parseCronField(weekday, 0, 7, weekdays)) {
+        logThrottled("Invalid cron field in: %s", expr);
+        return spec;
+    }
+
+    // Both 0 and 7 mean Sunday
+    if (weekdays & (1ULL << 7)) weekdays |= 1;
+
+    spec.minutes = minutes;
+    spec.hours = (uint32_t)hours;
+    spec.days = (uint32_t)days;
+    spec.months = (uint16_t)months;
+    spec.weekdays = (uint8_t)(weekdays & 0x7F);
+    spec.anyDay = (strcmp(day, "*") == 0);
+    spec.anyWeekday = (strcmp(weekday, "*") == 0);
+    spec.valid = true;
+    return spec;
+}
+
+// Fill a job from its JSON form, shared by the jobs file and WebSocket.
+// False if the cron expression is too long or malformed, the job is not usable then.
+bool jobFromJson(JsonVariantConst obj, jobStruct& job) {
+    job.id = obj["id"] | 0;
+    job.active = obj["active"] | false;
+    strlcpy(job.name, obj["name"] | "", sizeof(job.name));
+    int triggerType = obj["type"] | 0;
+    job.type = static_cast<JobTrigger>(triggerType);
+    job.moisture_min = obj["moisture_min"] | 20; // Default 20%
+    job.moisture_max = obj["moisture_max"] | 80; // Default 80%
+    job.plant = obj["plant"] | 0;
+    job.volume = obj["volume"] | 0;
+    job.duration = obj["duration"] | 0;
+    strlcpy(job.starttime, obj["starttime"] | "", sizeof(job.starttime));
+    job.everyday = obj["everyday"] | false;
+    const char* cron = obj["cron"] | "";
+    if (strlcpy(job.cron, cron, sizeof(job.cron)) >= sizeof(job.cron)) {
+        logThrottled("Cron expression of job %d is too long: %s", job.id, cron);
+        return false;
+    }
+    job.lastRunMillis = 0;
+    compileJobStartTime(job);
+    if (job.cron[0] != '\0' && !job.cronSpec.valid) {
+        logThrottled("Cron expression of job %d is invalid: %s", job.id, job.cron);
+        return false;
+    }
+    return true;
+}
+// Room for one job including its copied strings
+static const size_t JOB_JSON_SIZE = JSON_OBJECT_SIZE(16) + 512;
+
+// ArduinoJson reader over a buffer, each deserialization stops right after its value
+struct JsonBufferReader {
+    const char* pos;
+    const char* end;
+
+    int read() {
+        return pos < end ? (unsigned char)*pos++ : -1;
+    }
+
+    size_t readBytes(char* buffer, size_t length) {
+        size_t n = 0;
+        while (n < length && pos < end) buffer[n++] = *pos++;
+        return n;
+    }
+
+    // Next character that is not whitespace, left unread
+    int peek() {
+        while (pos < end && isspace((unsigned char)*pos)) pos++;
+        return pos < end ? (unsigned char)*pos : -1;
+    }
+};
+
+// Parses a JSON array of jobs one element at a time, the input starts at the '['
+bool jobListFromJson(const char* input, size_t length, std::vector<jobStruct>& jobs) {
+    JsonBufferReader reader = {input, input + length};
+    StaticJsonDocument<JOB_JSON_SIZE> doc;
+
+    if (reader.peek() != '[') return false;
+    reader.read();
+    if (reader.peek() == ']') return true;
+
+    for (;;) {
+        DeserializationError err = deserializeJson(doc, reader);
+        if (err) {
+            logThrottled("Job %u of the list is invalid: %s", (unsigned)jobs.size() + 1, err.c_str());
+            return false;
+        }
+
+        jobStruct job;
+        if (!jobFromJson(doc.as<JsonVariantConst>(), job)) return false;
+        jobs.push_back(job);
+
+        int next = reader.peek();
+        reader.read();
+        if (next == ']') return true;
+        if (next != ',') return false;
+    }
+}
@@ -1,9 +1,12 @@
 #include "scheduler/job_processor.h"
-#include "scheduler/job_parser.h"
+#include "scheduler/job_schedule.h"
+#include "scheduler/job_queue.h"
 #include "scheduler/job_state_machine.h"
 #include "hardware/moisture_sensor.h"
+#include "storage/run_journal.h"
 #include "config.h"
 #include "utils/logger.h"
+#include "utils/clock.h"
 #include <time.h>
 
 extern volatile bool otaUpdating;
@@ -44,153 +47,123 @@ bool checkMoistureTrigger(const jobStruct& job) {
     return false;
 }
 
-// Check if time-based job should trigger
-bool checkTimeTrigger(const jobStruct& job, int currentSecond, time_t now_t) {
-    if (job.starttime[0] == '\0') {
-        return false;
+// Log the trigger and queue the job unless it is already running
+void queueTriggeredJob(size_t jobIndex, const char* triggerReason, uint8_t priority) {
+    const jobStruct& job = joblistVec[jobIndex];
+
+    if (job.duration > 0) {
+        logThrottled("Job %d triggered (%s) - valve %d, duration %ds",
+                 job.id, triggerReason, job.plant + 1, job.duration);
+    }
+    if (job.volume > 0) {
+        logThrottled("Job %d triggered (%s) - valve %d, volume %dml",
+                 job.id, triggerReason, job.plant + 1, job.volume);
     }
 
-    jobDateTime dt = parseJobDateTime(job.starttime);
-    if (!dt.valid) {
-        return false;
+    if (isJobRunning(job.id)) {
+        logThrottled("Job %d due but already running - skipping", job.id);
+        return;
     }
 
-    const int startWindowSec = 30;
-    bool shouldStart = false;
-
-    if (job.everyday || dt.timeOnly) {
-        // Daily recurring job
-        int jobSecondsOfDay = dt.hour * 3600 + dt.minute * 60;
-        int diff = currentSecond - jobSecondsOfDay;
-        if (diff < 0) diff = -diff;
-        if (diff <= startWindowSec) shouldStart = true;
-    } else {
-        struct tm jobtm = {0};
-        jobtm.tm_year = dt.year - 1900;
-        jobtm.tm_mon = dt.month - 1;
-        jobtm.tm_mday = dt.day;
-        jobtm.tm_hour = dt.hour;
-        jobtm.tm_min = dt.minute;
-        jobtm.tm_sec = 0;
-        
-        struct tm currenttm;
-        localtime_r(&now_t, &currenttm);
-        
-        if (currenttm.tm_year == (dt.year - 1900) &&
-            currenttm.tm_mon == (dt.month - 1) &&
-            currenttm.tm_mday == dt.day) {
-            
-            int jobSecondsOfDay = dt.hour * 3600 + dt.minute * 60;
-            int currentSecondsOfDay = currenttm.tm_hour * 3600 + 
-                                    currenttm.tm_min * 60 + 
-                                    currenttm.tm_sec;
-            int diff = currentSecondsOfDay - jobSecondsOfDay;
-            if (diff < 0) diff = -diff;
-            
-            if (diff <= startWindowSec) {
-                shouldStart = true;
-            }
-        }
+    enqueueJobRun(jobIndex, priority);
+}
+
+// Pop the next queued run if it may start now and mark it started, else -1.
+// 'replacing' is a zone about to hand its slot to the job.
+int takeNextPendingJob(const ZoneRun* replacing) {
+    if (!auto_switch || otaUpdating) {
+        return -1;
     }
 
-    return shouldStart;
+    // Keep queue order, a run that does not fit blocks the ones behind it
+    int jobIndex = peekJobRun();
+    if (jobIndex < 0 || !canStartJob(joblistVec[jobIndex], replacing)) {
+        return -1;
+    }
+
+    dequeueJobRun();
+    joblistVec[jobIndex].lastRunMillis = clockMillis();
+    return jobIndex;
 }
 
-// Process a job based on its trigger type
-void jobsProcessor() {
-    static int lastCheckedSecond = -1;
-    static int lastExecutedJobId = -1;
-    static unsigned long lastJobStartTime = 0;
-    static unsigned long lastMoistureCheck = 0;
-    const unsigned long moistureCheckInterval = 300000; // Check moisture jobs every 5 minutes
+// Start queued runs as long as the pump has capacity for them
+void dispatchPendingJobs() {
+    int jobIndex;
+    while ((jobIndex = takeNextPendingJob()) >= 0) {
+        processJob(joblistVec[jobIndex]);
+    }
+}
 
-    time_t now_t = time(nullptr);
-    struct tm timeinfo;
-    localtime_r(&now_t, &timeinfo);
+// Look for time triggers that passed while rebooting or waiting for NTP
+static void queueMissedJobRuns(time_t now) {
+    time_t earliest = now - (time_t)settings.catchup_window * 3600;
 
-    int currentSecond = timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec;
-    bool newSecond = (currentSecond != lastCheckedSecond);
-    if (newSecond) {
-        lastCheckedSecond = currentSecond;
+    for (size_t i = 0; i < joblistVec.size(); i++) {
+        const jobStruct& job = joblistVec[i];
+        if (!job.active || job.type == TRIGGER_MOISTURE) continue;
+
+        // Jobs that never fired count from the last time the box was seen alive
+        time_t since = lastJobFire(job.journalKey);
+        if (since == 0) since = lastJournalSeen();
+        if (since == 0) continue;
+        if (since < earliest) since = earliest;
+
+        time_t missed = lastMissedFireTime(job, since, now);
+        if (missed == 0) continue;
+
+        if (settings.catchup_policy == CATCHUP_LATEST) {
+            recordJobFire(job.journalKey, missed);
+            queueTriggeredJob(i, "catch-up", JOB_PRIORITY_TIME);
+        } else {
+            logThrottled("Job %d missed a start while offline - skipping", job.id);
+        }
+    }
+}
+
+// Moisture listener, evaluates only the jobs attached to the sensor's plant
+void handleMoistureReading(size_t plant) {
+    if (!auto_switch || otaUpdating) {
+        return;
     }
 
-    if (timeinfo.tm_hour == 0 && timeinfo.tm_min == 0 && timeinfo.tm_sec == 0) {
-        lastExecutedJobId = -1;
+    uint32_t now = clockMillis();
+    for (size_t jobIndex : moistureJobsForPlant(plant)) {
+        const jobStruct& job = joblistVec[jobIndex];
+        // Give the soil time to respond before watering again
+        if (job.lastRunMillis != 0 && now - job.lastRunMillis < MOISTURE_JOB_COOLDOWN) continue;
+
+        if (checkMoistureTrigger(job)) {
+            queueTriggeredJob(jobIndex, "moisture-based", JOB_PRIORITY_MOISTURE);
+        }
     }
 
+    dispatchPendingJobs();
+}
+
+// Queue due time triggers and start what fits
+void jobsProcessor() {
+    static bool missedRunsChecked = false;
+
     if (otaUpdating) {
         logThrottled("OTA in progress - skipping job evaluation");
         return;
     }
 
-    unsigned long now = millis();
+    time_t now_t = clockTime();
 
-    if (now - lastJobStartTime < 60000) {
-        return;
+    // Catch up once the clock is valid after boot
+    if (!missedRunsChecked && now_t > 86400) {
+        missedRunsChecked = true;
+        queueMissedJobRuns(now_t);
     }
 
-    bool checkMoisture = (now - lastMoistureCheck >= moistureCheckInterval);
-    if (checkMoisture) {
-        lastMoistureCheck = now;
-    }
-
-    for (const jobStruct& job : joblistVec) {
-        // Skip if this job was the last executed one
-        if (job.id == lastExecutedJobId) continue;
-        // Skip if job is not active
-        if (!job.active) continue;
-
-        bool shouldTrigger = false;
-        const char* triggerReason = "";
-
-        switch (job.type) {
-            case TRIGGER_TIME:
-                // Only check time-based triggers on new seconds
-                if (newSecond && checkTimeTrigger(job, currentSecond, now_t)) {
-                    shouldTrigger = true;
-                    triggerReason = "time-based";
-                }
-                break;
-
-            case TRIGGER_MOISTURE:
-                // Check moisture triggers periodically
-                if (checkMoisture && checkMoistureTrigger(job)) {
-                    shouldTrigger = true;
-                    triggerReason = "moisture-based";
-                }
-                break;
-
-            case TRIGGER_BOTH:
-                // Check both conditions
-                if (newSecond && checkTimeTrigger(job, currentSecond, now_t)) {
-                    shouldTrigger = true;
-                    triggerReason = "time-based";
-                } else if (checkMoisture && checkMoistureTrigger(job)) {
-                    shouldTrigger = true;
-                    triggerReason = "moisture-based";
-                }
-                break;
-        }
-
-        if (shouldTrigger) {
-            if (job.duration > 0) {
-                logThrottled("Job %d triggered (%s) - valve %d, duration %.1fs",
-                         job.id, triggerReason, job.plant + 1, job.duration);
-            }
-            if (job.volume > 0) {
-                logThrottled("Job %d triggered (%s) - valve %d, volume %dml",
-                         job.id, triggerReason, job.plant + 1, job.volume);
-            }
-
-            if (jobActive) {
-                logThrottled("Job %d due but another job active - skipping", job.id);
-                continue;
-            }
-
-            processJob(job);
-            lastExecutedJobId = job.id;
-            lastJobStartTime = now;
-            break;
-        }
+    // Time-based triggers come from the schedule index
+    int jobIndex;
+    time_t fireAt;
+    while ((jobIndex = popDueScheduledJob(now_t, &fireAt)) >= 0) {
+        recordJobFire(joblistVec[jobIndex].journalKey, fireAt);
+        queueTriggeredJob(jobIndex, "time-based", JOB_PRIORITY_TIME);
     }
-}
\ No newline at end of file
+
+    dispatchPendingJobs();
+}
@@ -0,0 +1,87 @@
+#include "scheduler/job_queue.h"
+#include "utils/logger.h"
+
+struct PendingJobRun {
+    int jobId;
+    size_t jobIndex;
+    uint8_t priority;
+    uint32_t seq;
+};
+
+// Small bounded queue, ordered by priority then arrival
+static PendingJobRun pendingRuns[MAX_PENDING_JOB_RUNS];
+static size_t pendingCount = 0;
+static uint32_t nextSeq = 0;
+
+bool enqueueJobRun(size_t jobIndex, uint8_t priority) {
+    if (jobIndex >= joblistVec.size()) {
+        return false;
+    }
+
+    int jobId = joblistVec[jobIndex].id;
+
+    // Coalesce duplicates, keeping the more urgent priority
+    for (size_t i = 0; i < pendingCount; i++) {
+        if (pendingRuns[i].jobId == jobId) {
+            if (priority < pendingRuns[i].priority) {
+                pendingRuns[i].priority = priority;
+            }
+            return true;
+        }
+    }
+
+    if (pendingCount >= MAX_PENDING_JOB_RUNS) {
+        logThrottled("Job queue full - dropping job %d", jobId);
+        return false;
+    }
+
+    pendingRuns[pendingCount++] = {jobId, jobIndex, priority, nextSeq++};
+    logThrottled("Job %d queued (%d pending)", jobId, pendingCount);
+    return true;
+}
+
+// Slot of the next valid pending run, stale runs are dropped on the way
+static int headSlot() {
+    while (pendingCount > 0) {
+        size_t best = 0;
+        for (size_t i = 1; i < pendingCount; i++) {
+            if (pendingRuns[i].priority < pendingRuns[best].priority ||
+                (pendingRuns[i].priority == pendingRuns[best].priority &&
+                 (int32_t)(pendingRuns[i].seq - pendingRuns[best].seq) < 0)) {
+                best = i;
+            }
+        }
+
+        // The job list may have been replaced since the run was queued
+        const PendingJobRun& run = pendingRuns[best];
+        if (run.jobIndex < joblistVec.size() && joblistVec[run.jobIndex].id == run.jobId) {
+            return (int)best;
+        }
+        logThrottled("Queued job %d no longer in job list - dropping", run.jobId);
+        pendingRuns[best] = pendingRuns[--pendingCount];
+    }
+
+    return -1;
+}
+
+// Returns the joblistVec index of the next pending run without removing it, or -1
+int peekJobRun() {
+    int slot = headSlot();
+    return slot < 0 ? -1 : (int)pendingRuns[slot].jobIndex;
+}
+
+// Returns the joblistVec index of the next pending run, or -1
+int dequeueJobRun() {
+    int slot = headSlot();
+    if (slot < 0) {
+        return -1;
+    }
+
+    size_t jobIndex = pendingRuns[slot].jobIndex;
+    pendingRuns[slot] = pendingRuns[--pendingCount];
+    return (int)jobIndex;
+}
+
+size_t pendingJobRunCount() {
+    return pendingCount;
+}
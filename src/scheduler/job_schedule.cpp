@@ -0,0 +1,263 @@
+#include "scheduler/job_schedule.h"
+#include "scheduler/job_parser.h"
+#include "storage/run_journal.h"
+#include "utils/logger.h"
+#include <algorithm>
+
+struct ScheduleEntry {
+    time_t fireAt;
+    size_t jobIndex;
+};
+
+// Min-heap of upcoming time triggers, ordered by fire time
+static std::vector<ScheduleEntry> scheduleHeap;
+static bool scheduleDirty = true;
+
+// Reverse index plant -> joblistVec indices of jobs with a moisture trigger
+static std::vector<std::vector<size_t>> moistureJobIndex;
+static bool moistureIndexDirty = true;
+
+static bool firesLater(const ScheduleEntry& a, const ScheduleEntry& b) {
+    return a.fireAt > b.fireAt;
+}
+
+static uint32_t hashJobField(uint32_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Identifies a job in the run journal, a changed schedule counts as a new job.
+// Never negative, that is the journal's heartbeat.
+static int32_t jobJournalKey(const jobStruct& job) {
+    uint32_t hash = 2166136261u;
+    hash = hashJobField(hash, job.name, strlen(job.name) + 1);
+    hash = hashJobField(hash, &job.plant, sizeof(job.plant));
+    hash = hashJobField(hash, job.starttime, strlen(job.starttime) + 1);
+    hash = hashJobField(hash, &job.everyday, sizeof(job.everyday));
+    hash = hashJobField(hash, job.cron, strlen(job.cron) + 1);
+    return (int32_t)(hash & 0x7FFFFFFF);
+}
+
+// Parse starttime once so the scheduler never touches the string again
+void compileJobStartTime(jobStruct& job) {
+    job.startSecOfDay = -1;
+    job.startDate = 0;
+    job.cronSpec = parseCronExpression(job.cron);
+    job.journalKey = jobJournalKey(job);
+
+    if (job.cronSpec.valid || job.starttime[0] == '\0') {
+        return;
+    }
+
+    jobDateTime dt = parseJobDateTime(job.starttime);
+    if (!dt.valid) {
+        return;
+    }
+
+    job.startSecOfDay = dt.hour * 3600 + dt.minute * 60;
+    if (!job.everyday && !dt.timeOnly) {
+        job.startDate = dt.year * 10000 + dt.month * 100 + dt.day;
+    }
+}
+
+// Cron day match, day-of-month and day-of-week are ORed when both are set
+static bool cronDayMatches(const CronSpec& cron, const struct tm& t) {
+    if (!(cron.months & (1U << (t.tm_mon + 1)))) return false;
+
+    bool dayMatch = cron.days & (1UL << t.tm_mday);
+    bool weekdayMatch = cron.weekdays & (1U << t.tm_wday);
+
+    if (cron.anyDay) return weekdayMatch;
+    if (cron.anyWeekday) return dayMatch;
+    return dayMatch || weekdayMatch;
+}
+
+// First cron minute at or after 'from', 0 if none within four years
+static time_t nextCronFireTime(const CronSpec& cron, time_t from) {
+    struct tm t;
+    localtime_r(&from, &t);
+    if (t.tm_sec > 0) {
+        t.tm_min += 1;
+    }
+    t.tm_sec = 0;
+    t.tm_isdst = -1;
+    mktime(&t);
+
+    for (int day = 0; day < 4 * 366; day++) {
+        if (cronDayMatches(cron, t)) {
+            for (int hour = t.tm_hour; hour < 24; hour++) {
+                if (!(cron.hours & (1UL << hour))) continue;
+
+                int firstMinute = (hour == t.tm_hour) ? t.tm_min : 0;
+                uint64_t minutes = cron.minutes & (~0ULL << firstMinute);
+                if (minutes) {
+                    t.tm_hour = hour;
+                    t.tm_min = __builtin_ctzll(minutes);
+                    t.tm_isdst = -1;
+                    return mktime(&t);
+                }
+            }
+        }
+
+        t.tm_mday += 1;
+        t.tm_hour = 0;
+        t.tm_min = 0;
+        t.tm_isdst = -1;
+        mktime(&t);
+    }
+
+    return 0;
+}
+
+// First start of the job whose window has not yet closed at 'now', 0 if none
+static time_t nextFireTime(const jobStruct& job, time_t now) {
+    if (job.cronSpec.valid) {
+        return nextCronFireTime(job.cronSpec, now - JOB_START_WINDOW_SEC);
+    }
+    if (job.startSecOfDay < 0) {
+        return 0;
+    }
+
+    struct tm t = {0};
+    if (job.startDate == 0) {
+        localtime_r(&now, &t);
+    } else {
+        t.tm_year = job.startDate / 10000 - 1900;
+        t.tm_mon = (job.startDate / 100) % 100 - 1;
+        t.tm_mday = job.startDate % 100;
+    }
+    t.tm_hour = job.startSecOfDay / 3600;
+    t.tm_min = (job.startSecOfDay / 60) % 60;
+    t.tm_sec = 0;
+    t.tm_isdst = -1;
+
+    time_t fireAt = mktime(&t);
+    if (fireAt + JOB_START_WINDOW_SEC >= now) {
+        return fireAt;
+    }
+    if (job.startDate != 0) {
+        return 0;  // One-time job already passed
+    }
+
+    // Daily job already passed today, mktime normalizes the day overflow.
+    // It also moved a start inside a spring-forward gap, so set the time again.
+    t.tm_mday += 1;
+    t.tm_hour = job.startSecOfDay / 3600;
+    t.tm_min = (job.startSecOfDay / 60) % 60;
+    t.tm_sec = 0;
+    t.tm_isdst = -1;
+    return mktime(&t);
+}
+
+void invalidateJobSchedule() {
+    scheduleDirty = true;
+    moistureIndexDirty = true;
+}
+
+static void rebuildMoistureJobIndex() {
+    moistureJobIndex.clear();
+
+    for (size_t i = 0; i < joblistVec.size(); i++) {
+        const jobStruct& job = joblistVec[i];
+        if (!job.active || job.type == TRIGGER_TIME || job.plant < 0) continue;
+
+        if ((size_t)job.plant >= moistureJobIndex.size()) {
+            moistureJobIndex.resize(job.plant + 1);
+        }
+        moistureJobIndex[job.plant].push_back(i);
+    }
+    moistureIndexDirty = false;
+}
+
+// Active jobs triggered by the moisture of one plant
+const std::vector<size_t>& moistureJobsForPlant(size_t plant) {
+    static const std::vector<size_t> none;
+
+    if (moistureIndexDirty) {
+        rebuildMoistureJobIndex();
+    }
+    return plant < moistureJobIndex.size() ? moistureJobIndex[plant] : none;
+}
+
+void rebuildJobSchedule(time_t now) {
+    scheduleHeap.clear();
+
+    for (size_t i = 0; i < joblistVec.size(); i++) {
+        const jobStruct& job = joblistVec[i];
+        if (!job.active || job.type == TRIGGER_MOISTURE) continue;
+
+        // A start whose window is still open may already have fired before the rebuild
+        time_t fireAt = nextFireTime(job, now);
+        time_t lastFired = lastJobFire(job.journalKey);
+        while (fireAt != 0 && fireAt <= lastFired) {
+            fireAt = nextFireTime(job, fireAt + JOB_START_WINDOW_SEC + 1);
+        }
+        if (fireAt != 0) {
+            scheduleHeap.push_back({fireAt, i});
+        }
+    }
+
+    std::make_heap(scheduleHeap.begin(), scheduleHeap.end(), firesLater);
+    scheduleDirty = false;
+
+    logThrottled("Job schedule rebuilt: %u time trigger(s)", (unsigned)scheduleHeap.size());
+}
+
+// Most recent start after 'since' whose window closed before 'now', 0 if none
+time_t lastMissedFireTime(const jobStruct& job, time_t since, time_t now) {
+    time_t missed = 0;
+    time_t fireAt = nextFireTime(job, since + JOB_START_WINDOW_SEC + 1);
+
+    while (fireAt != 0 && fireAt + JOB_START_WINDOW_SEC < now) {
+        missed = fireAt;
+        fireAt = nextFireTime(job, fireAt + JOB_START_WINDOW_SEC + 1);
+    }
+    return missed;
+}
+
+// Returns the joblistVec index of the next due time trigger and its
+// scheduled start in 'fireAt', or -1
+int popDueScheduledJob(time_t now, time_t* fireAt) {
+    // Wait for NTP before computing any fire times
+    if (now <= 86400) {
+        return -1;
+    }
+
+    if (scheduleDirty) {
+        rebuildJobSchedule(now);
+    }
+
+    while (!scheduleHeap.empty()) {
+        ScheduleEntry top = scheduleHeap.front();
+        if (top.fireAt - JOB_START_WINDOW_SEC > now) {
+            return -1;
+        }
+
+        std::pop_heap(scheduleHeap.begin(), scheduleHeap.end(), firesLater);
+        scheduleHeap.pop_back();
+
+        const jobStruct& job = joblistVec[top.jobIndex];
+        if (job.startDate == 0) {
+            time_t next = nextFireTime(job, top.fireAt + JOB_START_WINDOW_SEC + 1);
+            if (next != 0) {
+                scheduleHeap.push_back({next, top.jobIndex});
+                std::push_heap(scheduleHeap.begin(), scheduleHeap.end(), firesLater);
+            }
+        }
+
+        if (now > top.fireAt + JOB_START_WINDOW_SEC) {
+            logThrottled("Job %d missed its start window", job.id);
+            continue;
+        }
+
+        if (fireAt != nullptr) {
+            *fireAt = top.fireAt;
+        }
+        return (int)top.jobIndex;
+    }
+
+    return -1;
+}
@@ -1,99 +1,335 @@
 #include "scheduler/job_state_machine.h"
 #include "hardware/valve_control.h"
 #include "hardware/pump_control.h"
+#include "hardware/flow_sensor.h"
 #include "utils/logger.h"
 #include "network/websocket_handler.h"
+#include "scheduler/job_processor.h"
+#include "scheduler/job_queue.h"
+#include "utils/clock.h"
+#include "utils/timer_wheel.h"
+
+static int jobStateTimer = -1;
+
+// Volume jobs stop on the flow sensor, duration only acts as a safety cap
+static bool isVolumeJob(const jobStruct& job) {
+    return settings.use_flowsensor && job.volume > 0;
+}
+
+// Pump flow a job needs in ml/min
+static int zoneFlowDemand(const jobStruct& job) {
+    // Unknown zones and metered volume jobs ask for more than the pump
+    // can deliver, so they always run alone
+    if (isVolumeJob(job) || job.plant < 0 || job.plant >= (int)settings.zone_flow.size() ||
+        settings.zone_flow[job.plant] == 0) {
+        return settings.pump_capacity + 1;
+    }
+    return settings.zone_flow[job.plant];
+}
+
+static bool isZoneActive(const ZoneRun& zone) {
+    return zone.state != JOB_IDLE;
+}
+
+// True if a zone other than 'self' has its valve open and wants the pump
+static bool pumpNeededByOthers(const ZoneRun& self) {
+    for (const ZoneRun& zone : zoneRuns) {
+        if (&zone == &self) continue;
+        if (zone.state == JOB_START_PUMP || zone.state == JOB_RUNNING || zone.state == JOB_HANDOFF_VALVE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void openZoneValve(int plant) {
+    if (!valve_switches[plant]) {
+        handleValveSwitch(plant);
+    }
+}
+
+static void closeZoneValve(int plant) {
+    if (valve_switches[plant]) {
+        handleValveSwitch(plant);
+    }
+}
+
+static void finishZone(ZoneRun& zone) {
+    zone.state = JOB_IDLE;
+    zone.handoffPlant = -1;
+}
+
+static void updateJobActive() {
+    jobActive = false;
+    for (const ZoneRun& zone : zoneRuns) {
+        if (isZoneActive(zone)) {
+            jobActive = true;
+            return;
+        }
+    }
+}
+
+// Admission control against free zone slots and pump capacity
+bool canStartJob(const jobStruct& job, const ZoneRun* replacing) {
+    int activeCount = 0;
+    int usedFlow = 0;
+
+    for (const ZoneRun& zone : zoneRuns) {
+        if (!isZoneActive(zone) || &zone == replacing) continue;
+        if (zone.job.plant == job.plant) return false;
+        activeCount++;
+        usedFlow += zoneFlowDemand(zone.job);
+    }
+
+    if (activeCount == 0) return true;
+    if (activeCount >= MAX_ZONE_RUNS) return false;
+    return usedFlow + zoneFlowDemand(job) <= settings.pump_capacity;
+}
+
+bool isJobRunning(int jobId) {
+    for (const ZoneRun& zone : zoneRuns) {
+        if (isZoneActive(zone) && zone.job.id == jobId) {
+            return true;
+        }
+    }
+    return false;
+}
 
 void processJob(const jobStruct& job) {
-    if (jobActive) {
-        logThrottled("Another job is active, skipping start");
+    if (!canStartJob(job, nullptr)) {
+        logThrottled("No pump capacity for job %d, skipping start", job.id);
+        return;
+    }
+
+    for (ZoneRun& zone : zoneRuns) {
+        if (isZoneActive(zone)) continue;
+
+        zone.job = job;
+        zone.state = JOB_OPEN_VALVE;
+        zone.stateTime = clockMillis();
+        zone.handoffPlant = -1;
+        jobActive = true;
+        if (!timerActive(jobStateTimer)) {
+            jobStateTimer = startTimer(0, JOB_STATE_INTERVAL, handleJobStateMachine);
+        }
+        logThrottled("Start background job: %s for plant: %d", job.name, job.plant + 1);
         return;
     }
-    
-    runningJob = job;
-    currentJobState = JOB_OPEN_VALVE;
-    jobStateTimestamp = millis();
-    jobActive = true;
-    logThrottled("Start background job: %s for plant: %s", job.type, job.plant);
 }
 
-void handleJobStateMachine() {
-    if (!jobActive) return;
+// Hand the running pump over to the next job instead of stopping it
+static bool startBatchHandoff(ZoneRun& zone, const jobStruct& next, uint32_t now) {
+    if (next.plant < 0 || next.plant >= settings.plant_count) {
+        logThrottled("Invalid plant number in job %d - skipping", next.id);
+        return false;
+    }
+
+    int previousPlant = zone.job.plant;
+    zone.job = next;
+    zone.stateTime = now;
+    logThrottled("Batch handoff to job: %s for plant: %d", next.name, next.plant + 1);
+
+    if (next.plant == previousPlant) {
+        zone.state = JOB_RUNNING;
+        zone.startPulses = getFlowPulseTotal();
+        return true;
+    }
 
-    unsigned long now = millis();
-    switch (currentJobState) {
+    // Open the next valve first so the pump is never dead-headed
+    openZoneValve(next.plant);
+    zone.handoffPlant = previousPlant;
+    zone.state = JOB_HANDOFF_VALVE;
+    return true;
+}
+
+static bool zoneRunComplete(const ZoneRun& zone, uint32_t now) {
+    const jobStruct& job = zone.job;
+    uint32_t elapsed = now - zone.stateTime;
+
+    if (isVolumeJob(job)) {
+        float deliveredMl = pulsesToLiters(getFlowPulseTotal() - zone.startPulses) * 1000.0f;
+        int maxDuration = job.duration > 0 ? job.duration : MAX_VOLUME_JOB_DURATION;
+
+        if (deliveredMl >= job.volume) {
+            logThrottled("Job %d volume reached (%.0fml)", job.id, deliveredMl);
+            return true;
+        }
+        if (elapsed >= (uint32_t)maxDuration * 1000UL) {
+            logThrottled("Job %d safety limit of %ds reached at %.0fml of %dml",
+                         job.id, maxDuration, deliveredMl, job.volume);
+            return true;
+        }
+        return false;
+    }
+
+    if (elapsed >= (uint32_t)job.duration * 1000UL) {
+        logThrottled("Job %d duration complete", job.id);
+        return true;
+    }
+    return false;
+}
+
+static void handleZoneRun(ZoneRun& zone, uint32_t now) {
+    switch (zone.state) {
         case JOB_IDLE:
             break;
-            
+
         case JOB_OPEN_VALVE: {
-            uint8_t plantNum = runningJob.plant;
-            //sscanf(runningJob.plant, "plant-%d", &plantNum);
-            
+            int plantNum = zone.job.plant;
+
             if (plantNum >= 0 && plantNum < settings.plant_count) {
-                handleValveSwitch(plantNum);
-                currentJobState = JOB_START_PUMP;
-                jobStateTimestamp = now;
+                openZoneValve(plantNum);
+                zone.state = JOB_START_PUMP;
+                zone.stateTime = now;
             } else {
                 logThrottled("Invalid plant number in job - aborting");
-                jobActive = false;
-                currentJobState = JOB_IDLE;
+                finishZone(zone);
             }
             break;
         }
-        
+
         case JOB_START_PUMP:
-            if (now - jobStateTimestamp >= 500) {
-                pumpCtx.manualControl = false;
-                pumpCtx.targetState = true;
-                pumpCtx.state = PUMP_STARTING;
-                handlePumpSwitch(false);
-                
+            if (now - zone.stateTime >= 500) {
+                if (pumpCtx.state == PUMP_RUNNING) {
+                    logThrottled("Job %s joined running pump", zone.job.name);
+                } else {
+                    pumpCtx.manualControl = false;
+                    pumpCtx.targetState = true;
+                    pumpCtx.state = PUMP_STARTING;
+                    handlePumpSwitch(false);
+                }
+
                 if (pumpCtx.state == PUMP_RUNNING) {
-                    logThrottled("Pump started for job: %s", runningJob.name);
-                    currentJobState = JOB_RUNNING;
-                    jobStateTimestamp = now;
+                    logThrottled("Pump started for job: %s", zone.job.name);
+                    zone.state = JOB_RUNNING;
+                    zone.stateTime = now;
+                    zone.startPulses = getFlowPulseTotal();
                 } else {
                     logThrottled("Failed to start pump for job - aborting");
-                    jobActive = false;
-                    currentJobState = JOB_IDLE;
+                    closeZoneValve(zone.job.plant);
+                    finishZone(zone);
                 }
             }
             break;
-            
+
         case JOB_RUNNING:
-            if (now - jobStateTimestamp >= (unsigned long)runningJob.duration * 1000UL) {
+            if (zoneRunComplete(zone, now)) {
+                // Other zones keep the pump running, only close this valve
+                if (pumpNeededByOthers(zone)) {
+                    closeZoneValve(zone.job.plant);
+                    zone.state = JOB_CLOSE_VALVE;
+                    zone.stateTime = now;
+                    break;
+                }
+
+                int nextIndex = settings.batch_watering ? takeNextPendingJob(&zone) : -1;
+                if (nextIndex >= 0 && startBatchHandoff(zone, joblistVec[nextIndex], now)) {
+                    break;
+                }
+
                 pumpCtx.manualControl = false;
                 pumpCtx.targetState = false;
                 pumpCtx.state = PUMP_STOPPING;
                 handlePumpSwitch(false);
-                currentJobState = JOB_STOP_PUMP;
-                jobStateTimestamp = now;
-                logThrottled("Job duration complete, stopping pump");
+                zone.state = JOB_STOP_PUMP;
+                zone.stateTime = now;
+                logThrottled("Stopping pump");
+            }
+            break;
+
+        case JOB_HANDOFF_VALVE:
+            if (now - zone.stateTime >= 500) {
+                closeZoneValve(zone.handoffPlant);
+                zone.handoffPlant = -1;
+                zone.state = JOB_RUNNING;
+                zone.stateTime = now;
+                zone.startPulses = getFlowPulseTotal();
+                logThrottled("Pump kept running for job: %s", zone.job.name);
+                notifyClients();
             }
             break;
-            
+
         case JOB_STOP_PUMP:
-            if (now - jobStateTimestamp >= 750) {
-                uint8_t plantNum = runningJob.plant;
-                //sscanf(runningJob.plant, "plant-%d", &plantNum);
-                
+            if (now - zone.stateTime >= 750) {
+                int plantNum = zone.job.plant;
+
+                if (zone.handoffPlant >= 0) {
+                    closeZoneValve(zone.handoffPlant);
+                    zone.handoffPlant = -1;
+                }
+
                 if (plantNum >= 0 && plantNum < settings.plant_count) {
-                    handleValveSwitch(plantNum);
-                    currentJobState = JOB_CLOSE_VALVE;
-                    jobStateTimestamp = now;
+                    closeZoneValve(plantNum);
+                    zone.state = JOB_CLOSE_VALVE;
+                    zone.stateTime = now;
                 } else {
                     logThrottled("Invalid plant number %d - aborting", plantNum + 1);
-                    jobActive = false;
-                    currentJobState = JOB_IDLE;
+                    finishZone(zone);
                 }
             }
             break;
-            
+
         case JOB_CLOSE_VALVE:
-            jobActive = false;
-            currentJobState = JOB_IDLE;
-            logThrottled("Job finished.");
+            finishZone(zone);
+            logThrottled("Job %d finished.", zone.job.id);
             notifyClients();
             break;
     }
-}
\ No newline at end of file
+}
+
+// Stop the pump at once, zones then close their valves on the usual stop path.
+// Queued runs are dropped, they would hit the same fault.
+void abortJobs(const char* reason) {
+    uint32_t now = clockMillis();
+
+    if (pumpCtx.state != PUMP_IDLE) {
+        pumpCtx.manualControl = false;
+        pumpCtx.targetState = false;
+        pumpCtx.state = PUMP_STOPPING;
+        handlePumpSwitch(false);
+    }
+
+    int aborted = 0;
+    for (ZoneRun& zone : zoneRuns) {
+        if (!isZoneActive(zone) || zone.state == JOB_STOP_PUMP || zone.state == JOB_CLOSE_VALVE) continue;
+
+        if (zone.state == JOB_OPEN_VALVE) {
+            finishZone(zone);
+        } else {
+            zone.state = JOB_STOP_PUMP;
+            zone.stateTime = now;
+        }
+        aborted++;
+    }
+
+    int dropped = 0;
+    while (dequeueJobRun() >= 0) {
+        dropped++;
+    }
+
+    updateJobActive();
+    logThrottled("Aborted %d job(s) and dropped %d queued run(s): %s", aborted, dropped, reason);
+    notifyClients();
+}
+
+// Timer callback, runs only while a zone is active
+void handleJobStateMachine() {
+    uint32_t now = clockMillis();
+    bool zoneFinished = false;
+
+    for (ZoneRun& zone : zoneRuns) {
+        bool wasActive = isZoneActive(zone);
+        handleZoneRun(zone, now);
+        if (wasActive && !isZoneActive(zone)) zoneFinished = true;
+    }
+    updateJobActive();
+
+    // A freed zone may let the next queued run start
+    if (zoneFinished) {
+        dispatchPendingJobs();
+    }
+
+    if (!jobActive) {
+        stopTimer(jobStateTimer);
+    }
+}
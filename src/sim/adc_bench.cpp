@@ -0,0 +1,188 @@
+/*
+  Host-side moisture ADC benchmark
+
+  Feeds a recorded sample trace through the moisture sensor acquisition
+  pipeline (burst sampling, median and EMA filter) and compares the noise
+  of single reads with the filtered readings.
+
+  pio run -e native_adc_bench
+  .pio/build/native_adc_bench/program trace.csv [--quiet]
+
+  Trace format: one line per sample instant with one raw 12-bit value per
+  channel, separated by commas or spaces. Lines starting with # are
+  skipped. Every ADC_BURST_SAMPLES lines make up one moisture reading.
+*/
+
+#include <Arduino.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdarg.h>
+
+#include "config.h"
+#include "hardware/adc_hal.h"
+#include "hardware/moisture_sensor.h"
+#include "utils/logger.h"
+
+Settings settings;
+std::vector<int> valveStates;
+
+static std::vector<std::vector<uint16_t>> traceRows;
+static size_t traceChannels = 0;
+static size_t tracePos = 0;
+
+unsigned long millis() {
+    return 0;
+}
+
+uint16_t analogRead(uint8_t pin) {
+    return 0;
+}
+
+void logThrottled(const char* format, ...) {
+}
+
+static bool traceBegin(const uint8_t* pins, size_t count) {
+    return count == traceChannels;
+}
+
+static size_t traceRead(uint16_t* samples, size_t bursts) {
+    size_t burst = 0;
+    for (; burst < bursts && tracePos < traceRows.size(); burst++, tracePos++) {
+        for (size_t channel = 0; channel < traceChannels; channel++) {
+            samples[burst * traceChannels + channel] = traceRows[tracePos][channel];
+        }
+    }
+    return burst;
+}
+
+static size_t traceReadChannel(size_t channel, uint16_t* samples, size_t count) {
+    size_t i = 0;
+    for (; i < count && tracePos < traceRows.size() && channel < traceChannels; i++, tracePos++) {
+        samples[i] = traceRows[tracePos][channel];
+    }
+    return i;
+}
+
+static const AdcHal traceAdc = {traceBegin, traceRead, traceReadChannel};
+
+static bool loadTrace(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Cannot open trace file: %s\n", path);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        for (char& c : line) {
+            if (c == ',' || c == ';' || c == '\t') c = ' ';
+        }
+
+        std::istringstream values(line);
+        std::vector<uint16_t> row;
+        int value;
+        while (values >> value) {
+            row.push_back((uint16_t)constrain(value, 0, 4095));
+        }
+        if (row.empty()) continue;
+
+        if (traceChannels == 0) traceChannels = row.size();
+        if (row.size() != traceChannels) {
+            fprintf(stderr, "Trace line %u has %u values, expected %u\n",
+                    (unsigned)traceRows.size() + 1, (unsigned)row.size(), (unsigned)traceChannels);
+            return false;
+        }
+        traceRows.push_back(row);
+    }
+
+    if (traceRows.size() < ADC_BURST_SAMPLES) {
+        fprintf(stderr, "Trace needs at least %u lines\n", (unsigned)ADC_BURST_SAMPLES);
+        return false;
+    }
+    return true;
+}
+
+// Mean absolute change between consecutive readings, in ADC counts
+struct NoiseStats {
+    double total = 0;
+    unsigned long count = 0;
+    int last = -1;
+
+    void add(int value) {
+        if (last >= 0) {
+            total += abs(value - last);
+            count++;
+        }
+        last = value;
+    }
+
+    double mean() const {
+        return count ? total / count : 0.0;
+    }
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <trace.csv> [--quiet]\n", argv[0]);
+        return 1;
+    }
+
+    bool quiet = argc > 2 && strcmp(argv[2], "--quiet") == 0;
+
+    if (!loadTrace(argv[1])) {
+        return 1;
+    }
+
+    settings.use_moisturesensor = true;
+    for (size_t channel = 0; channel < traceChannels; channel++) {
+        MoistureSensorData sensor = {};
+        sensor.pin = settings.moisture_start_pin + channel;
+        moistureSensors.push_back(sensor);
+    }
+
+    setAdcHal(&traceAdc);
+    beginMoistureSampling();
+
+    std::vector<NoiseStats> rawNoise(traceChannels);
+    std::vector<NoiseStats> filteredNoise(traceChannels);
+    unsigned long readings = 0;
+    double nsTotal = 0;
+    double nsMax = 0;
+
+    while (tracePos + ADC_BURST_SAMPLES <= traceRows.size()) {
+        // A single analogRead() per reading, as before the filter chain
+        const std::vector<uint16_t>& single = traceRows[tracePos];
+
+        auto t0 = std::chrono::steady_clock::now();
+        sampleMoistureSensors();
+        auto t1 = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        nsTotal += ns;
+        if (ns > nsMax) nsMax = ns;
+        readings++;
+
+        if (!quiet) printf("%lu", readings);
+        for (size_t channel = 0; channel < traceChannels; channel++) {
+            const MoistureSensorData& sensor = moistureSensors[channel];
+            rawNoise[channel].add(single[channel]);
+            filteredNoise[channel].add(sensor.analogValue);
+            if (!quiet) printf(" %4u/%4d/%3d%%", single[channel], sensor.analogValue, sensor.percentValue);
+        }
+        if (!quiet) printf("\n");
+    }
+
+    printf("\n%lu reading(s) of %u channel(s), %u samples each\n",
+           readings, (unsigned)traceChannels, (unsigned)ADC_BURST_SAMPLES);
+    for (size_t channel = 0; channel < traceChannels; channel++) {
+        printf("Channel %u: single read jitter %.1f, filtered jitter %.1f counts\n",
+               (unsigned)channel + 1, rawNoise[channel].mean(), filteredNoise[channel].mean());
+    }
+    printf("sampleMoistureSensors(): mean %.0f ns, max %.0f ns\n",
+           readings ? nsTotal / readings : 0.0, nsMax);
+    return 0;
+}
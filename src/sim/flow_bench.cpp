@@ -0,0 +1,211 @@
+/*
+  Host-side flow meter benchmark
+
+  Drives the flow sensor code with a synthetic pulse train on a virtual
+  clock and compares the reported flow rate and volume with the exact
+  values of the generated flow.
+
+  pio run -e native_flow_bench
+  .pio/build/native_flow_bench/program [options]
+
+  Options:
+    --seconds=N     Simulated run time (default 600)
+    --flow=N        Flow in ml/min (default 2000)
+    --profile=P     constant, ramp (0 to flow) or pulse (5 s on, 5 s off)
+    --jitter=PCT    Random variation of each pulse interval (default 10)
+    --glitches=N    Spurious short pulses per second (default 0)
+    --no-filter     Count glitches like the interrupt fallback does
+    --seed=N        Random seed (default 1)
+    --quiet         Only print the summary
+*/
+
+#include <Arduino.h>
+#include <chrono>
+#include <random>
+#include <stdarg.h>
+
+#include "config.h"
+#include "hardware/flow_meter.h"
+#include "hardware/flow_sensor.h"
+#include "utils/clock.h"
+
+static const unsigned long GLITCH_WIDTH_NS = 2000;
+static const unsigned long PULSE_WIDTH_NS = 5000000;
+
+static uint64_t simMicros = 0;
+static uint32_t meterPulses = 0;
+static unsigned long meterReads = 0;
+
+unsigned long millis() {
+    return (uint32_t)(simMicros / 1000);
+}
+
+static uint32_t simClockMillis() {
+    return millis();
+}
+
+static time_t simClockTime() {
+    return (time_t)(simMicros / 1000000);
+}
+
+static const ClockSource simClock = {simClockMillis, simClockTime};
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+}
+
+void detachInterrupt(uint8_t pin) {
+}
+
+void logThrottled(const char* format, ...) {
+}
+
+static bool fakeBegin(uint8_t pin) {
+    return true;
+}
+
+static uint32_t fakeRead() {
+    meterReads++;
+    return meterPulses;
+}
+
+static const FlowMeter fakeMeter = {fakeBegin, fakeRead};
+
+enum FlowProfile { PROFILE_CONSTANT, PROFILE_RAMP, PROFILE_PULSE };
+
+// Flow in L/min at a point in time
+static double profileFlow(FlowProfile profile, double liters, double t, double duration) {
+    switch (profile) {
+        case PROFILE_RAMP: return liters * t / duration;
+        case PROFILE_PULSE: return fmod(t, 10.0) < 5.0 ? liters : 0.0;
+        default: return liters;
+    }
+}
+
+static const char* optionValue(const char* arg, const char* name) {
+    size_t len = strlen(name);
+    return strncmp(arg, name, len) == 0 ? arg + len : nullptr;
+}
+
+int main(int argc, char** argv) {
+    int seconds = 600;
+    double flowLiters = 2.0;
+    double jitter = 0.10;
+    int glitchesPerSecond = 0;
+    bool filter = true;
+    bool quiet = false;
+    unsigned seed = 1;
+    FlowProfile profile = PROFILE_CONSTANT;
+
+    for (int i = 1; i < argc; i++) {
+        const char* value;
+        if ((value = optionValue(argv[i], "--seconds="))) seconds = atoi(value);
+        else if ((value = optionValue(argv[i], "--flow="))) flowLiters = atoi(value) / 1000.0;
+        else if ((value = optionValue(argv[i], "--jitter="))) jitter = atoi(value) / 100.0;
+        else if ((value = optionValue(argv[i], "--glitches="))) glitchesPerSecond = atoi(value);
+        else if ((value = optionValue(argv[i], "--seed="))) seed = atoi(value);
+        else if ((value = optionValue(argv[i], "--profile="))) {
+            if (strcmp(value, "ramp") == 0) profile = PROFILE_RAMP;
+            else if (strcmp(value, "pulse") == 0) profile = PROFILE_PULSE;
+            else if (strcmp(value, "constant") == 0) profile = PROFILE_CONSTANT;
+            else {
+                fprintf(stderr, "Unknown profile: %s\n", value);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--no-filter") == 0) filter = false;
+        else if (strcmp(argv[i], "--quiet") == 0) quiet = true;
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (seconds <= 0 || flowLiters <= 0) {
+        fprintf(stderr, "Invalid --seconds or --flow\n");
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    setClockSource(&simClock);
+    setFlowMeter(&fakeMeter);
+    initFlowSensor();
+
+    // Pulse phase advances with the flow, a pulse is due at every whole phase
+    double phase = 0;
+    double nextPulse = 1.0 + jitter * (2 * unit(rng) - 1);
+    double trueLiters = 0;
+    double secondLiters = 0;
+    unsigned long truePulses = 0;
+    unsigned long glitchPulses = 0;
+
+    double rateErrorTotal = 0;
+    double rateErrorMax = 0;
+    unsigned long rateSamples = 0;
+    unsigned long calcCalls = 0;
+    double calcNsTotal = 0;
+    double calcNsMax = 0;
+
+    const uint64_t endMicros = (uint64_t)seconds * 1000000;
+    const uint64_t stepMicros = 1000;
+
+    for (simMicros = stepMicros; simMicros <= endMicros; simMicros += stepMicros) {
+        double t = simMicros / 1e6;
+        double liters = profileFlow(profile, flowLiters, t, seconds);
+        double stepLiters = liters * stepMicros / 60e6;
+
+        trueLiters += stepLiters;
+        secondLiters += stepLiters;
+        phase += stepLiters * FLOW_SENSOR_PULSE_FACTOR * 60.0;
+        while (phase >= nextPulse) {
+            phase -= nextPulse;
+            nextPulse = 1.0 + jitter * (2 * unit(rng) - 1);
+            if (PULSE_WIDTH_NS >= FLOW_GLITCH_FILTER_NS || !filter) {
+                meterPulses++;
+            }
+            truePulses++;
+        }
+
+        if (glitchesPerSecond > 0 && unit(rng) < glitchesPerSecond * stepMicros / 1e6) {
+            glitchPulses++;
+            if (GLITCH_WIDTH_NS >= FLOW_GLITCH_FILTER_NS || !filter) {
+                meterPulses++;
+            }
+        }
+
+        if (simMicros % (PUMP_STATUS_INTERVAL * 1000) == 0) {
+            auto t0 = std::chrono::steady_clock::now();
+            calculateSoilFlowRate();
+            auto t1 = std::chrono::steady_clock::now();
+
+            double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+            calcCalls++;
+            calcNsTotal += ns;
+            if (ns > calcNsMax) calcNsMax = ns;
+
+            double trueRate = secondLiters * 60000.0 / PUMP_STATUS_INTERVAL;
+            double error = fabs(soilFlowRate - trueRate);
+            rateErrorTotal += error;
+            if (error > rateErrorMax) rateErrorMax = error;
+            rateSamples++;
+            secondLiters = 0;
+
+            if (!quiet) {
+                printf("%7.1f s  rate %6.3f/%6.3f L/min  volume %8.3f/%8.3f L\n",
+                       t, soilFlowRate, trueRate, soilFlowVolume, trueLiters);
+            }
+        }
+    }
+
+    double volumeError = trueLiters > 0 ? (soilFlowVolume - trueLiters) / trueLiters * 100.0 : 0.0;
+
+    printf("\nSimulated %d s, %lu pulse(s), %lu glitch(es) %s\n",
+           seconds, truePulses, glitchPulses, filter ? "filtered" : "counted");
+    printf("Volume: measured %.3f L, true %.3f L, error %+.2f%%\n", soilFlowVolume, trueLiters, volumeError);
+    printf("Rate error: mean %.4f L/min, max %.4f L/min over %lu update(s)\n",
+           rateSamples ? rateErrorTotal / rateSamples : 0.0, rateErrorMax, rateSamples);
+    printf("calculateSoilFlowRate(): mean %.0f ns, max %.0f ns, %lu meter read(s)\n",
+           calcCalls ? calcNsTotal / calcCalls : 0.0, calcNsMax, meterReads);
+    return 0;
+}
@@ -0,0 +1,379 @@
+/*
+  Host-side scheduler simulator
+
+  Replays a jobs file (same format as /schedules.json) against the real
+  scheduler, job state machine and pump control on a virtual clock and
+  prints every pump and valve transition.
+
+  pio run -e native_sim
+  .pio/build/native_sim/program schedules.json [options]
+
+  Options:
+    --days=N        Simulated days (default 365)
+    --start=DATE    First simulated day as YYYY-MM-DD (default Jan 1 this year)
+    --plants=N      Number of valves (default 8)
+    --tick=MS       Loop period in milliseconds (default 250)
+    --capacity=N    Pump capacity in ml/min (default 0)
+    --zone-flow=N   Flow demand of every valve in ml/min (default 0)
+    --flow=N        Simulated flow in ml/min while the pump runs (default 0)
+    --fault=F       From the second half on: dry (no flow), leak (flow with
+                    the pump off) or drift (three times the flow)
+    --batch         Keep the pump running between queued jobs
+    --log           Also print scheduler log lines
+    --quiet         Only print the summary
+
+  The timezone comes from TZ, defaulting to the firmware's CET/CEST rule.
+*/
+
+#include <Arduino.h>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <stdarg.h>
+
+#include "config.h"
+#include "hardware/moisture_sensor.h"
+#include "hardware/flow_meter.h"
+#include "hardware/flow_sensor.h"
+#include "scheduler/job_parser.h"
+#include "scheduler/job_processor.h"
+#include "scheduler/job_state_machine.h"
+#include "scheduler/flow_monitor.h"
+#include "storage/run_journal.h"
+#include "utils/clock.h"
+#include "utils/logger.h"
+#include "utils/timer_wheel.h"
+
+// Firmware globals normally defined in main.cpp and moisture_sensor.cpp
+Settings settings;
+std::vector<jobStruct> joblistVec;
+std::vector<int> valvePins;
+std::vector<bool> valve_switches;
+std::vector<int> valveStates;
+std::vector<MoistureSensorData> moistureSensors;
+bool auto_switch = true;
+bool pump_switch = false;
+int pumpState = 0;
+float pumpRunTime = 0;
+uint32_t pumpStartMillis = 0;
+bool jobActive = false;
+ZoneRun zoneRuns[MAX_ZONE_RUNS];
+PumpContext pumpCtx = {PUMP_IDLE, 0, false, false};
+NtpContext ntpCtx = {NTP_DONE, 0, 0, false, 0};
+volatile bool otaUpdating = false;
+
+// Virtual clock
+static uint64_t simMillis = 0;
+static time_t simEpochStart = 0;
+
+static bool printTransitions = true;
+static bool printLog = false;
+
+static int pinLevels[64];
+static unsigned long pumpStarts = 0;
+static unsigned long valveOpens = 0;
+static uint64_t pumpOnSince = 0;
+static uint64_t pumpOnTotal = 0;
+
+static uint32_t simPulses = 0;
+static unsigned long flowAlerts = 0;
+
+static unsigned long processorCalls = 0;
+static double processorNsTotal = 0;
+static double processorNsMax = 0;
+
+// The ESP32 millis() counter is 32 bits wide and wraps every ~49.7 days
+unsigned long millis() {
+    return (uint32_t)simMillis;
+}
+
+static uint32_t simClockMillis() {
+    return millis();
+}
+
+static time_t simClockTime() {
+    return simEpochStart + (time_t)(simMillis / 1000);
+}
+
+static const ClockSource simClock = {simClockMillis, simClockTime};
+
+static bool simFlowBegin(uint8_t pin) {
+    return true;
+}
+
+static uint32_t simFlowRead() {
+    return simPulses;
+}
+
+static const FlowMeter simFlowMeter = {simFlowBegin, simFlowRead};
+
+static void printTimestamp() {
+    time_t now = simClockTime();
+    struct tm t;
+    localtime_r(&now, &t);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &t);
+    printf("%s.%03u %s ", buf, (unsigned)(simMillis % 1000), t.tm_isdst > 0 ? "DST" : "STD");
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin >= sizeof(pinLevels) / sizeof(pinLevels[0]) || pinLevels[pin] == val) {
+        return;
+    }
+    pinLevels[pin] = val;
+
+    if (pin == pumpPin) {
+        if (val == HIGH) {
+            pumpStarts++;
+            pumpOnSince = simMillis;
+        } else {
+            pumpOnTotal += simMillis - pumpOnSince;
+        }
+        if (printTransitions) {
+            printTimestamp();
+            printf("pump %s\n", val == HIGH ? "ON" : "OFF");
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < valvePins.size(); i++) {
+        if (valvePins[i] == pin) {
+            if (val == HIGH) valveOpens++;
+            if (printTransitions) {
+                printTimestamp();
+                printf("valve %d %s\n", (int)i + 1, val == HIGH ? "OPEN" : "CLOSED");
+            }
+            return;
+        }
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < sizeof(pinLevels) / sizeof(pinLevels[0]) ? pinLevels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+}
+
+void detachInterrupt(uint8_t pin) {
+}
+
+size_t simStrlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+void logThrottled(const char* format, ...) {
+    if (!printLog) return;
+
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    printTimestamp();
+    printf("| %s\n", buffer);
+}
+
+void notifyClients() {
+}
+
+void sendFlowAlert(const char* type, int plant, int rate, int expected) {
+    flowAlerts++;
+    if (!printTransitions) return;
+    printTimestamp();
+    printf("flow alert %s, valve %d at %d ml/min, expected %d ml/min\n", type, plant, rate, expected);
+}
+
+// The run journal lives on LittleFS, the simulator only keeps the last fires
+static std::map<int32_t, time_t> simLastFires;
+
+void recordJobFire(int32_t jobKey, time_t fireAt) {
+    time_t& last = simLastFires[jobKey];
+    if (fireAt > last) last = fireAt;
+}
+
+time_t lastJobFire(int32_t jobKey) {
+    auto it = simLastFires.find(jobKey);
+    return it != simLastFires.end() ? it->second : 0;
+}
+
+time_t lastJournalSeen() {
+    return 0;
+}
+
+static bool loadSimJobs(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Cannot open jobs file: %s\n", path);
+        return false;
+    }
+
+    std::stringstream content;
+    content << file.rdbuf();
+    std::string json = content.str();
+
+    DynamicJsonDocument doc(json.size() * 2 + 1024);
+    DeserializationError err = deserializeJson(doc, json);
+    if (err || !doc.is<JsonArray>()) {
+        fprintf(stderr, "Invalid jobs file: %s\n", err ? err.c_str() : "not an array");
+        return false;
+    }
+
+    for (JsonVariantConst obj : doc.as<JsonArrayConst>()) {
+        jobStruct job;
+        if (!jobFromJson(obj, job)) {
+            fprintf(stderr, "Invalid job in jobs file\n");
+            return false;
+        }
+        joblistVec.push_back(job);
+    }
+    return true;
+}
+
+// Same tasks as main.cpp registers on the timer wheel
+static void simJobCheckTask() {
+    auto t0 = std::chrono::steady_clock::now();
+    jobsProcessor();
+    auto t1 = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    processorCalls++;
+    processorNsTotal += ns;
+    if (ns > processorNsMax) processorNsMax = ns;
+}
+
+static void simPumpStatusTask() {
+    if (settings.use_flowsensor || pumpState == HIGH) {
+        calculateSoilFlowRate();
+    }
+}
+
+static const char* optionValue(const char* arg, const char* name) {
+    size_t len = strlen(name);
+    return strncmp(arg, name, len) == 0 ? arg + len : nullptr;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <schedules.json> [--days=N] [--start=YYYY-MM-DD] [--plants=N] "
+                        "[--tick=MS] [--capacity=N] [--zone-flow=N] [--flow=N] [--fault=dry|leak|drift] "
+                        "[--batch] [--log] [--quiet]\n",
+                argv[0]);
+        return 1;
+    }
+
+    int days = 365;
+    int tickMs = 250;
+    int zoneFlow = 0;
+    int simFlow = 0;
+    const char* fault = "";
+    struct tm start = {0};
+    time_t wallNow = time(nullptr);
+    localtime_r(&wallNow, &start);
+    start.tm_mon = 0;
+    start.tm_mday = 1;
+
+    settings.plant_count = 8;
+
+    for (int i = 2; i < argc; i++) {
+        const char* value;
+        if ((value = optionValue(argv[i], "--days="))) days = atoi(value);
+        else if ((value = optionValue(argv[i], "--start="))) {
+            sscanf(value, "%d-%d-%d", &start.tm_year, &start.tm_mon, &start.tm_mday);
+            start.tm_year -= 1900;
+            start.tm_mon -= 1;
+        }
+        else if ((value = optionValue(argv[i], "--plants="))) settings.plant_count = atoi(value);
+        else if ((value = optionValue(argv[i], "--tick="))) tickMs = atoi(value);
+        else if ((value = optionValue(argv[i], "--capacity="))) settings.pump_capacity = atoi(value);
+        else if ((value = optionValue(argv[i], "--zone-flow="))) zoneFlow = atoi(value);
+        else if ((value = optionValue(argv[i], "--flow="))) simFlow = atoi(value);
+        else if ((value = optionValue(argv[i], "--fault="))) fault = value;
+        else if (strcmp(argv[i], "--batch") == 0) settings.batch_watering = true;
+        else if (strcmp(argv[i], "--log") == 0) printLog = true;
+        else if (strcmp(argv[i], "--quiet") == 0) printTransitions = false;
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (tickMs <= 0 || settings.plant_count == 0 || settings.plant_count > MAX_ZONE_RUNS) {
+        fprintf(stderr, "Invalid --tick or --plants\n");
+        return 1;
+    }
+
+    setenv("TZ", getenv("TZ") ? getenv("TZ") : "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+
+    start.tm_hour = 0;
+    start.tm_min = 0;
+    start.tm_sec = 0;
+    start.tm_isdst = -1;
+    simEpochStart = mktime(&start);
+    setClockSource(&simClock);
+    setFlowMeter(&simFlowMeter);
+    initFlowSensor();
+    setFlowListener(handleFlowSample);
+
+    settings.use_flowsensor = simFlow > 0;
+    settings.zone_flow.assign(settings.plant_count, zoneFlow);
+    for (uint8_t i = 0; i < settings.plant_count; i++) {
+        valvePins.push_back(settings.valve_start_pin + i);
+        valve_switches.push_back(false);
+        valveStates.push_back(LOW);
+    }
+
+    if (!loadSimJobs(argv[1])) {
+        return 1;
+    }
+
+    const uint64_t endMillis = (uint64_t)days * 86400000ULL;
+    double pendingPulses = 0;
+
+    startTimer(JOB_CHECK_INTERVAL, JOB_CHECK_INTERVAL, simJobCheckTask);
+    startTimer(PUMP_STATUS_INTERVAL, PUMP_STATUS_INTERVAL, simPumpStatusTask);
+
+    for (simMillis = 0; simMillis < endMillis; simMillis += tickMs) {
+        runTimers();
+
+        int flow = (pumpState == HIGH) ? simFlow : 0;
+        if (simMillis >= endMillis / 2) {
+            if (strcmp(fault, "dry") == 0) flow = 0;
+            else if (strcmp(fault, "leak") == 0 && pumpState != HIGH) flow = simFlow / 2;
+            else if (strcmp(fault, "drift") == 0) flow *= 3;
+        }
+
+        // Flow sensor delivers FLOW_SENSOR_PULSE_FACTOR pulses/s per L/min
+        pendingPulses += flow / 1000.0 * FLOW_SENSOR_PULSE_FACTOR * tickMs / 1000.0;
+        simPulses += (uint32_t)pendingPulses;
+        pendingPulses -= (int)pendingPulses;
+    }
+
+    if (pinLevels[pumpPin] == HIGH) {
+        pumpOnTotal += simMillis - pumpOnSince;
+    }
+
+    printf("\nSimulated %d day(s) of %u job(s) at %d ms ticks\n", days, (unsigned)joblistVec.size(), tickMs);
+    printf("Pump starts: %lu, valve openings: %lu, pump on: %.1f min\n",
+           pumpStarts, valveOpens, pumpOnTotal / 60000.0);
+    printf("jobsProcessor(): %lu calls, mean %.0f ns, max %.0f ns\n",
+           processorCalls, processorCalls ? processorNsTotal / processorCalls : 0.0, processorNsMax);
+    printf("Timer lateness max: %lu ms\n", timerMaxLateness());
+    if (settings.use_flowsensor) {
+        printf("Flow alerts: %lu\n", flowAlerts);
+    }
+    return 0;
+}
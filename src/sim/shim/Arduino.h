@@ -0,0 +1,39 @@
+#pragma once
+
+// Minimal Arduino API so the scheduler and sensor code build on the host
+
+// glibc declares a 'timezone' global that clashes with the one in config.h
+#define timezone glibc_timezone
+#include <time.h>
+#undef timezone
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define FALLING 0x02
+
+#define digitalPinToInterrupt(p) (p)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+
+size_t simStrlcpy(char* dst, const char* src, size_t size);
+#define strlcpy simStrlcpy
@@ -0,0 +1,5 @@
+#pragma once
+
+// The simulator has no web server, WebSocket notifications are stubbed
+class AsyncWebSocket;
+class AsyncWebSocketClient;
@@ -6,11 +6,16 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 
+// Room for up to MAX_CALIBRATION_POINTS [raw, percent] pairs per sensor
+#define CALIBRATION_JSON_SIZE(sensors) \
+    (JSON_ARRAY_SIZE(sensors) + (sensors) * (JSON_ARRAY_SIZE(MAX_CALIBRATION_POINTS) + \
+    MAX_CALIBRATION_POINTS * JSON_ARRAY_SIZE(2)))
+
 void loadConfiguration(const char* configfile) {
     if (LittleFS.exists(configfile)) {
         File file = LittleFS.open(configfile, "r");
         
-        const size_t capacity = JSON_OBJECT_SIZE(6) + 128;
+        const size_t capacity = JSON_OBJECT_SIZE(12) + JSON_ARRAY_SIZE(8) + CALIBRATION_JSON_SIZE(8) + 128;
         DynamicJsonDocument doc(capacity);
         
         DeserializationError error = deserializeJson(doc, file);
@@ -25,7 +30,28 @@ void loadConfiguration(const char* configfile) {
         settings.use_flowsensor = doc["use_flowsensor"] | false;
         settings.use_moisturesensor = doc["use_moisturesensor"] | false;
         settings.auto_switch = doc["auto_switch_enabled"] | false;
+        settings.batch_watering = doc["batch_watering"] | false;
         settings.plant_count = doc["plant_count"] | 3;
+        settings.pump_capacity = doc["pump_capacity"] | 0;
+        settings.catchup_policy = doc["catchup_policy"] | CATCHUP_SKIP;
+        settings.catchup_window = doc["catchup_window"] | 6;
+
+        settings.zone_flow.assign(settings.plant_count, 0);
+        for (uint8_t i = 0; i < settings.plant_count; i++) {
+            settings.zone_flow[i] = doc["zone_flow"][i] | 0;
+        }
+
+        settings.moisture_calibration.assign(settings.plant_count, {});
+        for (uint8_t i = 0; i < settings.plant_count; i++) {
+            JsonArray points = doc["moisture_calibration"][i].as<JsonArray>();
+            for (JsonVariant point : points) {
+                if (settings.moisture_calibration[i].size() >= MAX_CALIBRATION_POINTS) break;
+                int raw = point[0] | 0;
+                int percent = point[1] | 0;
+                settings.moisture_calibration[i].push_back(
+                    {(uint16_t)constrain(raw, 0, 4095), (uint8_t)constrain(percent, 0, 100)});
+            }
+        }
 
         if (settings.auto_switch) auto_switch = settings.auto_switch;
 
@@ -47,14 +73,34 @@ void saveConfiguration(const char* configfile) {
         return;
     }
 
-    const uint8_t size = JSON_OBJECT_SIZE(6);
-    StaticJsonDocument<size> doc;
+    const size_t capacity = JSON_OBJECT_SIZE(12) + JSON_ARRAY_SIZE(8) +
+        CALIBRATION_JSON_SIZE(settings.moisture_calibration.size());
+    DynamicJsonDocument doc(capacity);
 
     doc["use_webserial"] = settings.use_webserial;
     doc["use_flowsensor"] = settings.use_flowsensor;
     doc["use_moisturesensor"] = settings.use_moisturesensor;
     doc["auto_switch_enabled"] = settings.auto_switch;
+    doc["batch_watering"] = settings.batch_watering;
     doc["plant_count"] = settings.plant_count;
+    doc["pump_capacity"] = settings.pump_capacity;
+    doc["catchup_policy"] = settings.catchup_policy;
+    doc["catchup_window"] = settings.catchup_window;
+
+    JsonArray zoneFlow = doc.createNestedArray("zone_flow");
+    for (uint16_t flow : settings.zone_flow) {
+        zoneFlow.add(flow);
+    }
+
+    JsonArray calibration = doc.createNestedArray("moisture_calibration");
+    for (const std::vector<CalibrationPoint>& points : settings.moisture_calibration) {
+        JsonArray sensorPoints = calibration.createNestedArray();
+        for (const CalibrationPoint& point : points) {
+            JsonArray pair = sensorPoints.createNestedArray();
+            pair.add(point.raw);
+            pair.add(point.percent);
+        }
+    }
 
     if (serializeJson(doc, file) == 0) {
         logThrottled("Failed to write to configuration file");
@@ -1,5 +1,7 @@
 #include "storage/filesystem_manager.h"
 #include "config.h"
+#include "scheduler/job_schedule.h"
+#include "scheduler/job_parser.h"
 #include "utils/logger.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
@@ -52,41 +54,17 @@ void loadJobList(const char* jobsfile) {
         return;
     }
 
-    size_t cap = (size_t)content.length() * 2 + 1024;
-    const size_t CAP_MAX = 64 * 1024;
-    if (cap > CAP_MAX) cap = CAP_MAX;
-
-    DynamicJsonDocument doc(cap);
-    DeserializationError err = deserializeJson(doc, content);
-
-    if (err) {
-        logThrottled("Invalid JSON in jobs file: %s", err.c_str());
+    // Parsed job by job, no document for the whole file
+    std::vector<jobStruct> jobs;
+    if (!jobListFromJson(content.c_str(), content.length(), jobs)) {
+        logThrottled("Invalid JSON in jobs file");
         return;
     }
 
-    if (doc.is<JsonArray>()) {
-        JsonArray arr = doc.as<JsonArray>();
-        joblistVec.clear();
-
-        for (JsonObject obj : arr) {
-            jobStruct job;
-            job.id = obj["id"] | 0;
-            job.active = obj["active"] | false;
-            strlcpy(job.name, obj["name"] | "", sizeof(job.name));
-            int triggerType = obj["type"] | 0;
-            job.type = static_cast<JobTrigger>(triggerType);
-            job.moisture_min = obj["moisture_min"] | 20; // Default 20%
-            job.moisture_max = obj["moisture_max"] | 80; // Default 80%
-            job.plant = obj["plant"] | 0;
-            job.volume = obj["volume"] | 0;
-            job.duration = obj["duration"] | 0;
-            strlcpy(job.starttime, obj["starttime"] | "", sizeof(job.starttime));
-            job.everyday = obj["everyday"] | false;
-            joblistVec.push_back(job);
-        }
+    joblistVec.swap(jobs);
+    invalidateJobSchedule();
 
-        logThrottled("Loaded %d job(s)", joblistVec.size());
-    }
+    logThrottled("Loaded %u job(s)", (unsigned)joblistVec.size());
 }
 
 void saveJobList(const char* jobsfile) {
@@ -111,7 +89,7 @@ void saveJobList(const char* jobsfile) {
     }
 
     const size_t capacity = JSON_ARRAY_SIZE(joblen) + 
-                          (joblen * JSON_OBJECT_SIZE(11)) +
+                          (joblen * JSON_OBJECT_SIZE(12)) +
                           (joblen * 128);
     
     DynamicJsonDocument doc(capacity);
@@ -132,6 +110,7 @@ void saveJobList(const char* jobsfile) {
         obj["duration"] = job.duration;
         obj["starttime"] = job.starttime;
         obj["everyday"] = job.everyday;
+        obj["cron"] = job.cron;
     }
 
     size_t bytesWritten = serializeJson(doc, file);
@@ -158,4 +137,5 @@ void deleteJobList(const char* jobsfile) {
 
     logThrottled("Deleted jobs file");
     joblistVec.clear();
+    invalidateJobSchedule();
 }
\ No newline at end of file
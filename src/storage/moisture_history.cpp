@@ -0,0 +1,168 @@
+#include "storage/moisture_history.h"
+#include "hardware/moisture_sensor.h"
+
+struct HistoryTier {
+    uint32_t periodSec;
+    uint16_t length;
+    uint16_t offset;  // First point of the tier within a sensor's points
+};
+
+static const uint8_t HISTORY_TIER_COUNT = 3;
+static const HistoryTier historyTiers[HISTORY_TIER_COUNT] = {
+    {60, HISTORY_MINUTE_POINTS, 0},
+    {900, HISTORY_QUARTER_POINTS, HISTORY_MINUTE_POINTS},
+    {3600, HISTORY_HOUR_POINTS, HISTORY_MINUTE_POINTS + HISTORY_QUARTER_POINTS},
+};
+
+static const size_t HISTORY_POINTS_PER_SENSOR =
+    HISTORY_MINUTE_POINTS + HISTORY_QUARTER_POINTS + HISTORY_HOUR_POINTS;
+
+// Ring of closed periods plus the aggregate of the period still open.
+// Closed periods are contiguous, gaps are stored as empty points.
+struct HistoryRing {
+    uint32_t openPeriod;
+    uint16_t head;  // Slot the next closed period goes to
+    uint16_t count;
+    uint32_t sum;
+    uint16_t samples;
+    uint8_t min;
+    uint8_t max;
+};
+
+static MoistureAggregate historyPoints[MAX_HISTORY_SENSORS][HISTORY_POINTS_PER_SENSOR];
+static HistoryRing historyRings[MAX_HISTORY_SENSORS][HISTORY_TIER_COUNT];
+
+static_assert(sizeof(historyPoints) + sizeof(historyRings) <= MOISTURE_HISTORY_BUDGET,
+              "Moisture history tiers exceed MOISTURE_HISTORY_BUDGET");
+
+static const MoistureAggregate EMPTY_POINT = {255, 0, 0};
+
+static bool timeValid(time_t now) {
+    return now > 86400;
+}
+
+static void pushPoint(size_t sensor, uint8_t tier, const MoistureAggregate& point) {
+    const HistoryTier& spec = historyTiers[tier];
+    HistoryRing& ring = historyRings[sensor][tier];
+
+    historyPoints[sensor][spec.offset + ring.head] = point;
+    ring.head = (ring.head + 1) % spec.length;
+    if (ring.count < spec.length) ring.count++;
+}
+
+static void closePeriod(size_t sensor, uint8_t tier) {
+    HistoryRing& ring = historyRings[sensor][tier];
+    MoistureAggregate point = EMPTY_POINT;
+    if (ring.samples > 0) {
+        point = {ring.min, ring.max, (uint8_t)((ring.sum + ring.samples / 2) / ring.samples)};
+    }
+    pushPoint(sensor, tier, point);
+}
+
+static void addSample(size_t sensor, uint8_t tier, uint8_t percent, uint32_t period) {
+    const HistoryTier& spec = historyTiers[tier];
+    HistoryRing& ring = historyRings[sensor][tier];
+
+    if (ring.samples == 0 && ring.count == 0) {
+        ring.openPeriod = period;
+    } else if (period < ring.openPeriod) {
+        // Clock stepped back, keep the history consistent and drop the sample
+        return;
+    } else if (period > ring.openPeriod) {
+        closePeriod(sensor, tier);
+
+        uint32_t gap = period - ring.openPeriod - 1;
+        if (gap >= spec.length) {
+            ring.head = 0;
+            ring.count = 0;
+        } else {
+            for (uint32_t i = 0; i < gap; i++) {
+                pushPoint(sensor, tier, EMPTY_POINT);
+            }
+        }
+        ring.openPeriod = period;
+        ring.samples = 0;
+    }
+
+    if (ring.samples == 0) {
+        ring.sum = 0;
+        ring.min = percent;
+        ring.max = percent;
+    }
+    ring.sum += percent;
+    ring.samples++;
+    if (percent < ring.min) ring.min = percent;
+    if (percent > ring.max) ring.max = percent;
+}
+
+void recordMoistureSample(size_t sensor, uint8_t percent, time_t now) {
+    if (sensor >= MAX_HISTORY_SENSORS || !timeValid(now)) return;
+
+    for (uint8_t tier = 0; tier < HISTORY_TIER_COUNT; tier++) {
+        addSample(sensor, tier, percent, (uint32_t)now / historyTiers[tier].periodSec);
+    }
+}
+
+void recordMoistureHistory(time_t now) {
+    for (size_t i = 0; i < moistureSensors.size(); i++) {
+        recordMoistureSample(i, (uint8_t)moistureSensors[i].percentValue, now);
+    }
+}
+
+// Finest tier that still reaches back to 'from' and fits into one reply
+bool queryMoistureHistory(size_t sensor, time_t from, time_t to, MoistureHistoryRange& range) {
+    if (sensor >= MAX_HISTORY_SENSORS || to < from) return false;
+
+    for (uint8_t tier = 0; tier < HISTORY_TIER_COUNT; tier++) {
+        const HistoryTier& spec = historyTiers[tier];
+        const HistoryRing& ring = historyRings[sensor][tier];
+        if (ring.count == 0 && ring.samples == 0) return false;
+
+        uint32_t oldest = ring.openPeriod - ring.count;
+        uint32_t newest = ring.openPeriod;
+        uint32_t first = (uint32_t)from / spec.periodSec;
+        uint32_t last = (uint32_t)to / spec.periodSec;
+        if (first < oldest) first = oldest;
+        if (last > newest) last = newest;
+
+        bool lastTier = (tier + 1 == HISTORY_TIER_COUNT);
+        // A ring that never wrapped holds everything coarser tiers have
+        bool reachesBack = (uint32_t)from / spec.periodSec >= oldest || ring.count < spec.length;
+        bool fits = last < first || last - first < MAX_HISTORY_QUERY_POINTS;
+        if (!lastTier && !(reachesBack && fits)) continue;
+
+        if (last < first) {
+            range.count = 0;
+        } else {
+            if (last - first >= MAX_HISTORY_QUERY_POINTS) {
+                first = last - MAX_HISTORY_QUERY_POINTS + 1;
+            }
+            range.count = last - first + 1;
+        }
+        range.sensor = sensor;
+        range.tier = tier;
+        range.start = (time_t)first * spec.periodSec;
+        range.step = spec.periodSec;
+        return true;
+    }
+    return false;
+}
+
+bool moistureHistoryPoint(const MoistureHistoryRange& range, uint16_t index, MoistureAggregate& point) {
+    const HistoryTier& spec = historyTiers[range.tier];
+    const HistoryRing& ring = historyRings[range.sensor][range.tier];
+    uint32_t period = (uint32_t)range.start / spec.periodSec + index;
+
+    if (period == ring.openPeriod) {
+        if (ring.samples == 0) return false;
+        point = {ring.min, ring.max, (uint8_t)((ring.sum + ring.samples / 2) / ring.samples)};
+        return true;
+    }
+    if (period > ring.openPeriod || ring.openPeriod - period > ring.count) return false;
+
+    // Closed periods end just before head
+    uint32_t back = ring.openPeriod - period;
+    uint16_t slot = (ring.head + spec.length - back) % spec.length;
+    point = historyPoints[range.sensor][spec.offset + slot];
+    return point.min <= point.max;
+}
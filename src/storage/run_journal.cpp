@@ -0,0 +1,189 @@
+#include "storage/run_journal.h"
+#include "config.h"
+#include "utils/logger.h"
+#include "utils/clock.h"
+#include "utils/timer_wheel.h"
+#include <LittleFS.h>
+
+// One append-only entry, jobKey -1 records the last known valid time
+struct JournalRecord {
+    int32_t jobKey;  // jobStruct::journalKey, list ids are renumbered on every save
+    uint32_t fireAt;
+};
+
+static const int32_t JOURNAL_HEARTBEAT_ID = -1;
+
+static const char* journalPath = nullptr;
+static std::vector<JournalRecord> lastFires;
+static time_t lastSeen = 0;
+
+static bool timeValid(time_t now) {
+    return now > 86400;
+}
+
+static void applyRecord(const JournalRecord& rec) {
+    if (rec.jobKey == JOURNAL_HEARTBEAT_ID) {
+        if ((time_t)rec.fireAt > lastSeen) lastSeen = rec.fireAt;
+        return;
+    }
+
+    for (JournalRecord& entry : lastFires) {
+        if (entry.jobKey == rec.jobKey) {
+            if (rec.fireAt > entry.fireAt) entry.fireAt = rec.fireAt;
+            return;
+        }
+    }
+    lastFires.push_back(rec);
+}
+
+static bool writeRecords(File& file, const JournalRecord* records, size_t count) {
+    size_t bytes = count * sizeof(JournalRecord);
+    return file.write((const uint8_t*)records, bytes) == bytes;
+}
+
+// Rewrite the journal with one record per known job plus the heartbeat
+static void compactRunJournal() {
+    String tmpPath = String(journalPath) + ".tmp";
+    File file = LittleFS.open(tmpPath.c_str(), "w");
+    if (!file) {
+        logThrottled("Failed to create run journal");
+        return;
+    }
+
+    bool ok = true;
+    for (const JournalRecord& entry : lastFires) {
+        for (const jobStruct& job : joblistVec) {
+            if (job.journalKey == entry.jobKey) {
+                ok = ok && writeRecords(file, &entry, 1);
+                break;
+            }
+        }
+    }
+    if (lastSeen != 0) {
+        JournalRecord heartbeat = {JOURNAL_HEARTBEAT_ID, (uint32_t)lastSeen};
+        ok = ok && writeRecords(file, &heartbeat, 1);
+    }
+    file.close();
+
+    if (!ok) {
+        logThrottled("Failed to write compacted run journal");
+        LittleFS.remove(tmpPath.c_str());
+        return;
+    }
+    if (LittleFS.exists(journalPath) && !LittleFS.remove(journalPath)) {
+        logThrottled("Failed to remove old run journal");
+        return;
+    }
+    if (!LittleFS.rename(tmpPath.c_str(), journalPath)) {
+        logThrottled("Failed to rename compacted run journal");
+        return;
+    }
+    logThrottled("Run journal compacted");
+}
+
+// Timer callback, records the last known valid time
+static void runJournalHeartbeat() {
+    if (timeValid(clockTime())) {
+        flushRunJournal();
+    }
+}
+
+void loadRunJournal(const char* journalfile) {
+    journalPath = journalfile;
+    lastFires.clear();
+    lastSeen = 0;
+    startTimer(RUN_JOURNAL_HEARTBEAT, RUN_JOURNAL_HEARTBEAT, runJournalHeartbeat);
+
+    if (!LittleFS.exists(journalPath)) {
+        logThrottled("Run journal '%s' does not exist", journalPath);
+        return;
+    }
+
+    File file = LittleFS.open(journalPath, "r");
+    if (!file) {
+        logThrottled("Failed to open run journal: %s", journalPath);
+        return;
+    }
+
+    // A torn trailing record from a power loss is ignored
+    JournalRecord rec;
+    size_t count = 0;
+    while (file.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec)) {
+        applyRecord(rec);
+        count++;
+    }
+    size_t size = file.size();
+    file.close();
+
+    logThrottled("Run journal loaded: %u record(s), %u job(s)", (unsigned)count, (unsigned)lastFires.size());
+
+    if (size > RUN_JOURNAL_MAX_BYTES) {
+        compactRunJournal();
+    }
+}
+
+// Append the record, if any, and a heartbeat in a single write
+static void appendRunJournal(const JournalRecord* rec) {
+    if (journalPath == nullptr) return;
+
+    JournalRecord records[2];
+    size_t count = 0;
+    if (rec != nullptr) {
+        records[count++] = *rec;
+    }
+
+    time_t now = clockTime();
+    if (timeValid(now)) {
+        JournalRecord heartbeat = {JOURNAL_HEARTBEAT_ID, (uint32_t)now};
+        applyRecord(heartbeat);
+        records[count++] = heartbeat;
+    }
+
+    if (count == 0) return;
+
+    // Records stay in memory even if the write fails, only reboots lose them
+    File file = LittleFS.open(journalPath, "a");
+    if (!file) {
+        logThrottled("Failed to open run journal for writing");
+        return;
+    }
+
+    bool ok = writeRecords(file, records, count);
+    size_t size = file.size();
+    file.close();
+
+    if (!ok) {
+        logThrottled("Failed to write run journal");
+        return;
+    }
+
+    if (size > RUN_JOURNAL_MAX_BYTES) {
+        compactRunJournal();
+    }
+}
+
+// Written right away, a fire lost to a power cut would be caught up and water twice
+void recordJobFire(int32_t jobKey, time_t fireAt) {
+    JournalRecord rec = {jobKey, (uint32_t)fireAt};
+    applyRecord(rec);
+    appendRunJournal(&rec);
+}
+
+time_t lastJobFire(int32_t jobKey) {
+    for (const JournalRecord& entry : lastFires) {
+        if (entry.jobKey == jobKey) {
+            return entry.fireAt;
+        }
+    }
+    return 0;
+}
+
+time_t lastJournalSeen() {
+    return lastSeen;
+}
+
+// Records the last known valid time.
+// Loop task only, the journal state is not locked.
+void flushRunJournal() {
+    appendRunJournal(nullptr);
+}
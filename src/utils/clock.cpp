@@ -0,0 +1,24 @@
+#include "utils/clock.h"
+
+static uint32_t systemMillis() {
+    return millis();
+}
+
+static time_t systemTime() {
+    return time(nullptr);
+}
+
+static const ClockSource systemClock = {systemMillis, systemTime};
+static const ClockSource* activeClock = &systemClock;
+
+void setClockSource(const ClockSource* source) {
+    activeClock = (source != nullptr) ? source : &systemClock;
+}
+
+uint32_t clockMillis() {
+    return activeClock->millis();
+}
+
+time_t clockTime() {
+    return activeClock->time();
+}
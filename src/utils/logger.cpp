@@ -1,14 +1,27 @@
 #include "utils/logger.h"
 #include "config.h"
+#include "utils/timer_wheel.h"
 #include <WebSerialLite.h>
+#include <mutex>
 #include <queue>
 
 static unsigned long lastLogMillis = 0;
+// Filled from any task, drained by the loop task
 static std::queue<String> webSerialQueue;
+static std::mutex webSerialMutex;
+static LogListener logListener = nullptr;
 
 void initLogger() {
     Serial.begin(115200);
     lastLogMillis = 0;
+
+    // Always armed, logging from the async_tcp task must not touch the timer wheel
+    unsigned long interval = WEBSERIAL_FLUSH_INTERVAL > 0 ? WEBSERIAL_FLUSH_INTERVAL : TIMER_TICK_MS;
+    startTimer(interval, interval, processWebSerialQueue);
+}
+
+void setLogListener(LogListener listener) {
+    logListener = listener;
 }
 
 void logThrottled(const char* format, ...) {
@@ -27,22 +40,26 @@ void logThrottled(const char* format, ...) {
     if (settings.use_webserial) {
         queueWebSerial(buffer);
     }
+    if (logListener) {
+        logListener(buffer);
+    }
 }
 
 void queueWebSerial(const char* message) {
+    std::lock_guard<std::mutex> lock(webSerialMutex);
     if (webSerialQueue.size() < 50) {
         webSerialQueue.push(String(message));
     }
 }
 
+// Timer callback, sends one message per interval
 void processWebSerialQueue() {
-    static unsigned long lastFlush = 0;
-    unsigned long now = millis();
-
-    if (now - lastFlush >= WEBSERIAL_FLUSH_INTERVAL && !webSerialQueue.empty()) {
-        String msg = webSerialQueue.front();
+    String msg;
+    {
+        std::lock_guard<std::mutex> lock(webSerialMutex);
+        if (webSerialQueue.empty()) return;
+        msg = webSerialQueue.front();
         webSerialQueue.pop();
-        WebSerial.println(msg);
-        lastFlush = now;
     }
+    WebSerial.println(msg);
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "utils/timer_wheel.h"
+#include "config.h"
+#include "utils/clock.h"
+
+// Four levels of 64 slots, each level 64 times coarser than the one below.
+// With 10ms ticks this covers about 46 hours, longer timers are re-cascaded.
+static const uint8_t WHEEL_BITS = 6;
+static const uint8_t WHEEL_SLOTS = 1 << WHEEL_BITS;
+static const uint8_t WHEEL_MASK = WHEEL_SLOTS - 1;
+static const uint8_t WHEEL_LEVELS = 4;
+static const uint32_t WHEEL_SPAN = 1UL << (WHEEL_BITS * WHEEL_LEVELS);
+
+struct Timer {
+    TimerCallback callback;
+    uint32_t expires;        // Wheel tick the timer is due
+    uint32_t periodTicks;    // 0 for one-shot timers
+    uint32_t dueMs;          // For lateness statistics
+    uint16_t generation;     // Invalidates ids of stopped timers
+    int8_t prev;
+    int8_t next;
+    int16_t bucket;          // Slot list the timer is linked into, -1 if free
+};
+
+static Timer timers[MAX_TIMERS];
+static int8_t wheel[WHEEL_LEVELS * WHEEL_SLOTS];
+static bool wheelReady = false;
+
+static uint32_t wheelTime = 0;        // Last processed tick
+static uint32_t wheelMillis = 0;      // millis() of the last processed tick
+static unsigned long maxLateness = 0;
+
+static void initWheel() {
+    for (int8_t& slot : wheel) slot = -1;
+    for (Timer& timer : timers) timer.bucket = -1;
+    wheelMillis = clockMillis();
+    wheelReady = true;
+}
+
+static void linkTimer(int8_t index, int16_t bucket) {
+    Timer& timer = timers[index];
+    timer.bucket = bucket;
+    timer.prev = -1;
+    timer.next = wheel[bucket];
+    if (timer.next >= 0) timers[timer.next].prev = index;
+    wheel[bucket] = index;
+}
+
+static void unlinkTimer(int8_t index) {
+    Timer& timer = timers[index];
+    if (timer.prev >= 0) timers[timer.prev].next = timer.next;
+    else wheel[timer.bucket] = timer.next;
+    if (timer.next >= 0) timers[timer.next].prev = timer.prev;
+    timer.bucket = -1;
+}
+
+// Put a timer into the slot of the coarsest level that still resolves it
+static void insertTimer(int8_t index) {
+    uint32_t expires = timers[index].expires;
+    uint32_t delta = expires - wheelTime;
+
+    if (delta >= WHEEL_SPAN) {
+        expires = wheelTime + WHEEL_SPAN - 1;
+        delta = WHEEL_SPAN - 1;
+    }
+
+    uint8_t level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1UL << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    uint8_t slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    linkTimer(index, level * WHEEL_SLOTS + slot);
+}
+
+// Move the timers of one slot down to finer levels, returns the slot index
+static uint8_t cascade(uint8_t level) {
+    uint8_t slot = (wheelTime >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    int16_t bucket = level * WHEEL_SLOTS + slot;
+
+    while (wheel[bucket] >= 0) {
+        int8_t index = wheel[bucket];
+        unlinkTimer(index);
+        insertTimer(index);
+    }
+    return slot;
+}
+
+static void advanceWheel() {
+    wheelTime++;
+
+    uint8_t slot = wheelTime & WHEEL_MASK;
+    if (slot == 0) {
+        for (uint8_t level = 1; level < WHEEL_LEVELS && cascade(level) == 0; level++) {
+        }
+    }
+
+    while (wheel[slot] >= 0) {
+        int8_t index = wheel[slot];
+        Timer& timer = timers[index];
+        TimerCallback callback = timer.callback;
+        uint32_t now = clockMillis();
+
+        unlinkTimer(index);
+
+        uint32_t lateness = now - timer.dueMs;
+        if (lateness > maxLateness) maxLateness = lateness;
+
+        // Re-arm before the callback so it can stop or restart itself,
+        // periods missed while the loop was blocked are skipped
+        if (timer.periodTicks > 0) {
+            int32_t periodMs = timer.periodTicks * TIMER_TICK_MS;
+            do {
+                timer.expires += timer.periodTicks;
+                timer.dueMs += periodMs;
+            } while ((int32_t)(now - timer.dueMs) >= periodMs);
+            insertTimer(index);
+        } else {
+            timer.generation++;
+        }
+
+        callback();
+    }
+}
+
+static unsigned long msToTicks(unsigned long ms) {
+    unsigned long ticks = (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    return ticks > 0 ? ticks : 1;
+}
+
+// Returns a timer id, or -1 if all timers are in use
+int startTimer(unsigned long delayMs, unsigned long periodMs, TimerCallback callback) {
+    if (!wheelReady) initWheel();
+
+    for (int8_t index = 0; index < MAX_TIMERS; index++) {
+        Timer& timer = timers[index];
+        if (timer.bucket >= 0) continue;
+
+        // The wheel lags the clock by up to one tick
+        uint32_t now = clockMillis();
+        timer.callback = callback;
+        timer.expires = wheelTime + msToTicks(now - wheelMillis + delayMs);
+        timer.periodTicks = periodMs > 0 ? msToTicks(periodMs) : 0;
+        timer.dueMs = now + delayMs;
+        insertTimer(index);
+        return (timer.generation << 8) | index;
+    }
+    return -1;
+}
+
+void stopTimer(int timerId) {
+    if (!timerActive(timerId)) return;
+
+    int index = timerId & 0xFF;
+    unlinkTimer(index);
+    timers[index].generation++;
+}
+
+bool timerActive(int timerId) {
+    if (timerId < 0) return false;
+
+    int index = timerId & 0xFF;
+    if (index >= MAX_TIMERS) return false;
+    return timers[index].bucket >= 0 && timers[index].generation == (uint16_t)(timerId >> 8);
+}
+
+// Advance the wheel to the current time and fire due timers
+void runTimers() {
+    if (!wheelReady) initWheel();
+
+    // 32-bit arithmetic so the millis() wrap is harmless on any host
+    uint32_t now = clockMillis();
+    while ((uint32_t)(now - wheelMillis) >= TIMER_TICK_MS) {
+        wheelMillis += TIMER_TICK_MS;
+        advanceWheel();
+    }
+}
+
+// Worst delay between a timer's due time and its callback
+unsigned long timerMaxLateness() {
+    return maxLateness;
+}
+
+void resetTimerMaxLateness() {
+    maxLateness = 0;
+}
@@ -0,0 +1,111 @@
+/*
+  Host tests of the time-trigger schedule
+
+  pio test -e native_test
+*/
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <unity.h>
+
+#include "config.h"
+#include "scheduler/job_schedule.h"
+
+// Firmware globals and services the scheduler links against
+Settings settings;
+std::vector<jobStruct> joblistVec;
+
+void logThrottled(const char* format, ...) {
+}
+
+size_t simStrlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+time_t lastJobFire(int32_t jobKey) {
+    return 0;
+}
+
+static time_t localTime(int year, int month, int day, int hour, int minute) {
+    struct tm t = {0};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = minute;
+    t.tm_isdst = -1;
+    return mktime(&t);
+}
+
+static void addDailyJob(const char* starttime) {
+    jobStruct job = {0};
+    job.id = joblistVec.size() + 1;
+    job.active = true;
+    job.everyday = true;
+    job.type = TRIGGER_TIME;
+    strlcpy(job.name, "daily", sizeof(job.name));
+    strlcpy(job.starttime, starttime, sizeof(job.starttime));
+    compileJobStartTime(job);
+    joblistVec.push_back(job);
+}
+
+// Scheduled starts of all jobs between 'from' and 'to', polled once a minute
+static std::vector<time_t> collectFires(time_t from, time_t to) {
+    std::vector<time_t> fires;
+    for (time_t now = from; now < to; now += 60) {
+        time_t fireAt;
+        while (popDueScheduledJob(now, &fireAt) >= 0) {
+            fires.push_back(fireAt);
+        }
+    }
+    return fires;
+}
+
+void setUp() {
+    joblistVec.clear();
+    invalidateJobSchedule();
+}
+
+void tearDown() {
+}
+
+// 02:30 does not exist on the spring-forward day, the start moves to 03:30
+// that day only
+static void test_daily_start_in_spring_forward_gap() {
+    addDailyJob("02:30");
+
+    std::vector<time_t> fires = collectFires(localTime(2026, 3, 28, 0, 0), localTime(2026, 4, 1, 0, 0));
+
+    TEST_ASSERT_EQUAL_UINT(4, fires.size());
+    TEST_ASSERT_EQUAL_INT64(localTime(2026, 3, 28, 2, 30), fires[0]);
+    TEST_ASSERT_EQUAL_INT64(localTime(2026, 3, 29, 3, 30), fires[1]);
+    TEST_ASSERT_EQUAL_INT64(localTime(2026, 3, 30, 2, 30), fires[2]);
+    TEST_ASSERT_EQUAL_INT64(localTime(2026, 3, 31, 2, 30), fires[3]);
+}
+
+// 02:30 exists twice on the fall-back day, the job still starts once
+static void test_daily_start_in_fall_back_overlap() {
+    addDailyJob("02:30");
+
+    std::vector<time_t> fires = collectFires(localTime(2026, 10, 24, 0, 0), localTime(2026, 10, 27, 0, 0));
+
+    TEST_ASSERT_EQUAL_UINT(3, fires.size());
+    TEST_ASSERT_EQUAL_INT64(localTime(2026, 10, 24, 2, 30), fires[0]);
+    TEST_ASSERT_EQUAL_INT64(localTime(2026, 10, 26, 2, 30), fires[2]);
+}
+
+int main(int argc, char** argv) {
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_daily_start_in_spring_forward_gap);
+    RUN_TEST(test_daily_start_in_fall_back_overlap);
+    return UNITY_END();
+}